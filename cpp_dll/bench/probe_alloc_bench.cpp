@@ -0,0 +1,143 @@
+// Counts heap allocations on the per-probe path: encoding an echo request
+// into a reused buffer, patching the sequence number of a prebuilt request,
+// and decoding a reply in place. Once warmed up each should allocate
+// nothing; the exit status is 1 if any of them does.
+//
+//   probe_alloc_bench [iterations]
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <span>
+#include <string>
+
+#include "icmp_utils.hpp"
+
+namespace {
+std::atomic<std::size_t> allocations{0};
+
+void *counted_allocation(std::size_t size) {
+  allocations.fetch_add(1, std::memory_order_relaxed);
+  if (auto *memory = std::malloc(size ? size : 1)) {
+    return memory;
+  }
+  throw std::bad_alloc();
+}
+} // namespace
+
+void *operator new(std::size_t size) { return counted_allocation(size); }
+void *operator new[](std::size_t size) { return counted_allocation(size); }
+void operator delete(void *memory) noexcept { std::free(memory); }
+void operator delete[](void *memory) noexcept { std::free(memory); }
+void operator delete(void *memory, std::size_t) noexcept { std::free(memory); }
+void operator delete[](void *memory, std::size_t) noexcept {
+  std::free(memory);
+}
+
+namespace {
+// Runs `probe` once to warm up, then `iterations` times, and reports the
+// allocations and time per call. Returns whether it allocated.
+template <class Probe>
+bool measure(const char *name, std::size_t iterations, Probe &&probe) {
+  using clock = std::chrono::steady_clock;
+
+  probe(0);
+  allocations.store(0, std::memory_order_relaxed);
+  auto start = clock::now();
+  for (std::size_t i = 0; i < iterations; ++i) {
+    probe(static_cast<unsigned short>(i));
+  }
+  auto elapsed = std::chrono::duration<double, std::nano>(clock::now() - start);
+  auto counted = allocations.load(std::memory_order_relaxed);
+  std::printf("%-28s %8.3f allocations/probe %8.1f ns/probe\n", name,
+              static_cast<double>(counted) / static_cast<double>(iterations),
+              elapsed.count() / static_cast<double>(iterations));
+  return counted != 0;
+}
+
+void write_word(std::span<std::byte> bytes, std::size_t offset,
+                unsigned short value) {
+  bytes[offset] = static_cast<std::byte>(value >> 8);
+  bytes[offset + 1] = static_cast<std::byte>(value & 0xFF);
+}
+
+// Turns the echo request in `icmp` into the matching echo reply, patching
+// the checksum for the changed type.
+template <class IPType> void make_echo_reply(std::span<std::byte> icmp) {
+  net::icmp_header_view view(icmp);
+  auto request_type = static_cast<unsigned short>(view.type() << 8);
+  auto reply_type = static_cast<unsigned short>(
+      net::select_icmp_type<IPType>(net::icmp_header::ipv4::echo_reply,
+                                    net::icmp_header::ipv6::echo_reply)
+      << 8);
+  write_word(icmp, 2,
+             net::checksum_update(view.checksum(), request_type, reply_type));
+  icmp[0] = static_cast<std::byte>(reply_type >> 8);
+}
+} // namespace
+
+int main(int argc, char **argv) {
+  std::size_t iterations = argc > 1 ? std::stoul(argv[1]) : 1'000'000;
+  bool allocated = false;
+
+  alignas(16) std::array<std::byte, 256> out{};
+  allocated |= measure("encode_echo_request", iterations,
+                       [&](unsigned short sequence_number) {
+                         net::encode_echo_request<net::use_ipv4_t>(
+                             out, 0x1234, sequence_number, net::echo_body);
+                       });
+
+  net::echo_request_template<net::use_ipv4_t> request(0x1234, net::echo_body);
+  allocated |= measure("echo_request_template::next", iterations,
+                       [&](unsigned short sequence_number) {
+                         request.next(sequence_number);
+                       });
+
+  // An IPv4 packet as a raw socket reads it: a 20-byte header without
+  // options, then the echo reply.
+  std::array<std::byte, 256> v4_packet{};
+  auto v4_icmp = std::span(v4_packet).subspan(20);
+  auto v4_length = 20 + net::encode_echo_request<net::use_ipv4_t>(
+                            v4_icmp, 0x1234, 7, net::echo_body)
+                            .size();
+  make_echo_reply<net::use_ipv4_t>(v4_icmp);
+  v4_packet[0] = std::byte{0x45};
+  write_word(v4_packet, 2, static_cast<unsigned short>(v4_length));
+  v4_packet[8] = std::byte{64};
+  v4_packet[9] = std::byte{1};
+  std::array<std::byte, 4> loopback{std::byte{127}, std::byte{0},
+                                    std::byte{0}, std::byte{1}};
+  std::copy(loopback.begin(), loopback.end(), v4_packet.begin() + 12);
+  std::copy(loopback.begin(), loopback.end(), v4_packet.begin() + 16);
+  asio::ip::icmp::endpoint v4_sender(asio::ip::address_v4::loopback(), 0);
+  net::icmp_reply<net::use_ipv4_t> v4_reply;
+  allocated |= measure("decode_reply ipv4", iterations, [&](unsigned short) {
+    if (net::decode_reply<net::use_ipv4_t>(
+            std::span(v4_packet).first(v4_length), v4_sender, v4_reply.ip_hdr,
+            v4_reply.icmp_hdr) != net::decode_result::reply) {
+      std::abort();
+    }
+  });
+
+  // An ICMPv6 socket starts at the ICMPv6 header.
+  std::array<std::byte, 256> v6_packet{};
+  auto v6_length = net::encode_echo_request<net::use_ipv6_t>(
+                       v6_packet, 0x1234, 7, net::echo_body)
+                       .size();
+  make_echo_reply<net::use_ipv6_t>(v6_packet);
+  asio::ip::icmp::endpoint v6_sender(asio::ip::address_v6::loopback(), 0);
+  net::icmp_reply<net::use_ipv6_t> v6_reply;
+  allocated |= measure("decode_reply ipv6", iterations, [&](unsigned short) {
+    if (net::decode_reply<net::use_ipv6_t>(
+            std::span(v6_packet).first(v6_length), v6_sender, v6_reply.ip_hdr,
+            v6_reply.icmp_hdr) != net::decode_result::reply) {
+      std::abort();
+    }
+  });
+
+  return allocated ? 1 : 0;
+}
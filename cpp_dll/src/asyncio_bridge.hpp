@@ -0,0 +1,241 @@
+#ifndef ASYNCIO_BRIDGE_HPP
+#define ASYNCIO_BRIDGE_HPP
+
+#include <asio.hpp>
+#include <atomic>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <pybind11/pybind11.h>
+#include <unordered_map>
+#include <utility>
+
+#include "engine.hpp"
+#include "metrics.hpp"
+
+namespace net::asyncio {
+namespace py = pybind11;
+
+// Cleared by the module's atexit hook. Once the interpreter is going away
+// completion handlers still sitting in the engine must not touch Python.
+inline std::atomic_bool &interpreter_alive() noexcept {
+  static std::atomic_bool alive{true};
+  return alive;
+}
+
+// The future a completion resolves. It may be destroyed on an engine thread,
+// so the reference is dropped under the GIL.
+struct future_state {
+  py::object future;
+
+  future_state() = default;
+  future_state(const future_state &) = delete;
+  future_state &operator=(const future_state &) = delete;
+
+  ~future_state() {
+    if (!interpreter_alive().load(std::memory_order_acquire)) {
+      future.release();
+      return;
+    }
+    py::gil_scoped_acquire acquire;
+    future = py::object();
+  }
+};
+
+// Completions waiting to be run on one event loop. Engine threads push them
+// onto a lock-free stack, and only a push onto an empty stack wakes the loop,
+// which then runs everything queued by that time in one go. A burst of
+// results from several engine threads thus costs one wake-up, instead of one
+// GIL acquisition per result on the engine side.
+class loop_queue : public std::enable_shared_from_this<loop_queue> {
+public:
+  using completion = std::move_only_function<void()>;
+
+  explicit loop_queue(py::object loop) : loop_(std::move(loop)) {}
+
+  ~loop_queue() {
+    drop(take());
+    if (!interpreter_alive().load(std::memory_order_acquire)) {
+      loop_.release();
+      return;
+    }
+    py::gil_scoped_acquire acquire;
+    loop_ = py::object();
+  }
+
+  loop_queue(const loop_queue &) = delete;
+  loop_queue &operator=(const loop_queue &) = delete;
+
+  // The queue of the running loop. Needs the GIL, which also guards the
+  // registry.
+  static std::shared_ptr<loop_queue> for_running_loop() {
+    static std::unordered_map<PyObject *, std::weak_ptr<loop_queue>> queues;
+    py::object loop = py::module_::import("asyncio").attr("get_running_loop")();
+    // A live queue holds its loop, so a key is never a recycled address.
+    std::erase_if(queues,
+                  [](const auto &entry) { return entry.second.expired(); });
+    auto &known = queues[loop.ptr()];
+    auto queue = known.lock();
+    if (!queue) {
+      queue = std::make_shared<loop_queue>(std::move(loop));
+      known = queue;
+    }
+    return queue;
+  }
+
+  const py::object &loop() const noexcept { return loop_; }
+
+  // Called on engine threads, without the GIL. `complete` runs on the loop
+  // thread with the GIL held.
+  void push(completion complete) {
+    auto *added = new node{std::move(complete), nullptr};
+    module_metrics::instance().completions_pending.add();
+    auto *head = head_.load(std::memory_order_relaxed);
+    do {
+      added->next = head;
+    } while (!head_.compare_exchange_weak(head, added,
+                                          std::memory_order_release,
+                                          std::memory_order_relaxed));
+    if (head) {
+      // The drain scheduled by the push that found the stack empty will
+      // take this one too.
+      return;
+    }
+    py::gil_scoped_acquire acquire;
+    try {
+      loop_.attr("call_soon_threadsafe")(
+          py::cpp_function([self = shared_from_this()] { self->drain(); }));
+    } catch (py::error_already_set &) {
+      // The loop is closed; nobody is waiting for the results any more.
+      drop(take());
+    }
+  }
+
+private:
+  struct node {
+    completion complete;
+    node *next;
+  };
+
+  // Empties the stack and returns its nodes oldest first.
+  node *take() noexcept {
+    auto *head = head_.exchange(nullptr, std::memory_order_acquire);
+    node *oldest = nullptr;
+    while (head) {
+      auto *next = head->next;
+      head->next = oldest;
+      oldest = head;
+      head = next;
+    }
+    return oldest;
+  }
+
+  static void drop(node *nodes) noexcept {
+    while (nodes) {
+      std::unique_ptr<node> current(nodes);
+      nodes = current->next;
+      module_metrics::instance().completions_pending.sub();
+    }
+  }
+
+  void drain() {
+    auto *nodes = take();
+    while (nodes) {
+      std::unique_ptr<node> current(nodes);
+      nodes = current->next;
+      module_metrics::instance().completions_pending.sub();
+      try {
+        current->complete();
+      } catch (py::error_already_set &e) {
+        e.discard_as_unraisable("network_utils_externel_cpp completion");
+      }
+    }
+  }
+
+  std::atomic<node *> head_{nullptr};
+  py::object loop_;
+};
+
+// Spawns the awaitable on the shared engine and returns an asyncio.Future
+// bound to the running loop. On completion the converter is called on the
+// loop thread, by way of the loop's loop_queue, and its result is set on the
+// future. The converter receives (std::exception_ptr, T) and must not throw
+// C++ exceptions; it reports failures in the returned object instead.
+//
+// Cancelling the future cancels the operation: whatever it is waiting on is
+// aborted on the engine, and its sockets and timers are released as it
+// unwinds.
+template <class T, class Converter>
+py::object spawn(asio::awaitable<T> awaitable, Converter converter) {
+  auto queue = loop_queue::for_running_loop();
+  auto state = std::make_shared<future_state>();
+  state->future = queue->loop().attr("create_future")();
+  py::object future = state->future;
+  // The operation and its cancellation stay on this context.
+  auto executor = engine::instance().get_executor();
+
+  // Emitted on the engine, which owns the operation, and kept alive by the
+  // completion handler until the operation no longer listens to it.
+  auto cancel = std::make_shared<asio::cancellation_signal>();
+  future.attr("add_done_callback")(
+      py::cpp_function([executor, cancel](py::object done) {
+        if (done.attr("cancelled")().cast<bool>()) {
+          asio::post(executor, [cancel] {
+            cancel->emit(asio::cancellation_type::terminal);
+          });
+        }
+      }));
+
+  asio::co_spawn(
+      executor, std::move(awaitable),
+      asio::bind_cancellation_slot(
+          cancel->slot(),
+          [queue = std::move(queue), state = std::move(state),
+           converter = std::move(converter),
+           cancel](std::exception_ptr error, T value) mutable {
+            if (!interpreter_alive().load(std::memory_order_acquire)) {
+              return;
+            }
+            queue->push([state = std::move(state),
+                         converter = std::move(converter), error,
+                         value = std::move(value)]() mutable {
+              py::object result = converter(error, std::move(value));
+              // The future may have been cancelled meanwhile.
+              if (!state->future.attr("done")().cast<bool>()) {
+                state->future.attr("set_result")(std::move(result));
+              }
+            });
+          }));
+  return future;
+}
+
+// A Python callable that engine threads can invoke for results streamed
+// while an operation is still running. Each call is queued on the loop that
+// was running when the callback was bound, so Python sees it on that thread.
+class loop_callback {
+public:
+  explicit loop_callback(py::object callback)
+      : queue_(loop_queue::for_running_loop()),
+        state_(std::make_shared<future_state>()) {
+    state_->future = std::move(callback);
+  }
+
+  // The arguments are copied, so they must not be Python objects.
+  template <class... Args> void operator()(Args &&...args) const {
+    if (!interpreter_alive().load(std::memory_order_acquire)) {
+      return;
+    }
+    queue_->push([state = state_, ... args = std::forward<Args>(args)] {
+      state->future(args...);
+    });
+  }
+
+private:
+  std::shared_ptr<loop_queue> queue_;
+  // Reuses the future's slot for the callable, with the same GIL-safe
+  // teardown.
+  std::shared_ptr<future_state> state_;
+};
+} // namespace net::asyncio
+
+#endif // ASYNCIO_BRIDGE_HPP
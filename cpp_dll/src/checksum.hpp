@@ -0,0 +1,158 @@
+#ifndef CHECKSUM_HPP
+#define CHECKSUM_HPP
+
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <span>
+
+#if defined(__AVX2__) || defined(__SSE2__) || defined(_M_X64)
+#include <immintrin.h>
+#endif
+
+// The Internet checksum (RFC 1071) used by ICMP.
+//
+// The one's complement sum does not depend on byte order, so the kernel adds
+// the data as native-endian words, as wide as the CPU allows, and swaps the
+// folded result once at the end. Sums of several buffers can be chained as
+// long as every buffer but the last has an even length.
+
+namespace net {
+namespace detail {
+inline std::uint64_t checksum_add_scalar(const std::byte *data,
+                                         std::size_t size,
+                                         std::uint64_t sum) noexcept {
+  while (size >= 8) {
+    std::uint64_t chunk;
+    std::memcpy(&chunk, data, sizeof(chunk));
+    sum += (chunk & 0xFFFFFFFF) + (chunk >> 32);
+    data += 8;
+    size -= 8;
+  }
+  if (size >= 4) {
+    std::uint32_t chunk;
+    std::memcpy(&chunk, data, sizeof(chunk));
+    sum += chunk;
+    data += 4;
+    size -= 4;
+  }
+  if (size >= 2) {
+    std::uint16_t chunk;
+    std::memcpy(&chunk, data, sizeof(chunk));
+    sum += chunk;
+    data += 2;
+    size -= 2;
+  }
+  if (size) {
+    // An odd byte is the high-order byte of a word padded with zero.
+    std::uint16_t chunk = 0;
+    std::memcpy(&chunk, data, 1);
+    sum += chunk;
+  }
+  return sum;
+}
+
+#if defined(__AVX2__)
+// Widens 16-bit words into 32-bit lanes; each lane takes at most 0xFFFF per
+// step, so lanes are flushed before they could overflow.
+inline std::uint64_t checksum_add_simd(const std::byte *&data,
+                                       std::size_t &size,
+                                       std::uint64_t sum) noexcept {
+  constexpr std::size_t block = 32;
+  constexpr std::size_t max_steps = 0x8000;
+  const __m256i zero = _mm256_setzero_si256();
+  while (size >= block) {
+    __m256i lanes = _mm256_setzero_si256();
+    for (std::size_t steps = 0; size >= block && steps < max_steps;
+         ++steps) {
+      __m256i chunk =
+          _mm256_loadu_si256(reinterpret_cast<const __m256i *>(data));
+      lanes = _mm256_add_epi32(lanes, _mm256_unpacklo_epi16(chunk, zero));
+      lanes = _mm256_add_epi32(lanes, _mm256_unpackhi_epi16(chunk, zero));
+      data += block;
+      size -= block;
+    }
+    alignas(32) std::uint32_t parts[8];
+    _mm256_store_si256(reinterpret_cast<__m256i *>(parts), lanes);
+    for (auto part : parts) {
+      sum += part;
+    }
+  }
+  return sum;
+}
+#elif defined(__SSE2__) || defined(_M_X64)
+inline std::uint64_t checksum_add_simd(const std::byte *&data,
+                                       std::size_t &size,
+                                       std::uint64_t sum) noexcept {
+  constexpr std::size_t block = 16;
+  constexpr std::size_t max_steps = 0x8000;
+  const __m128i zero = _mm_setzero_si128();
+  while (size >= block) {
+    __m128i lanes = _mm_setzero_si128();
+    for (std::size_t steps = 0; size >= block && steps < max_steps;
+         ++steps) {
+      __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data));
+      lanes = _mm_add_epi32(lanes, _mm_unpacklo_epi16(chunk, zero));
+      lanes = _mm_add_epi32(lanes, _mm_unpackhi_epi16(chunk, zero));
+      data += block;
+      size -= block;
+    }
+    alignas(16) std::uint32_t parts[4];
+    _mm_store_si128(reinterpret_cast<__m128i *>(parts), lanes);
+    for (auto part : parts) {
+      sum += part;
+    }
+  }
+  return sum;
+}
+#else
+inline std::uint64_t checksum_add_simd(const std::byte *&, std::size_t &,
+                                       std::uint64_t sum) noexcept {
+  return sum;
+}
+#endif
+} // namespace detail
+
+// Adds `bytes` to a running, unfolded checksum.
+inline std::uint64_t checksum_add(std::span<const std::byte> bytes,
+                                  std::uint64_t sum = 0) noexcept {
+  const std::byte *data = bytes.data();
+  std::size_t size = bytes.size();
+  sum = detail::checksum_add_simd(data, size, sum);
+  return detail::checksum_add_scalar(data, size, sum);
+}
+
+// Folds a running sum into the 16-bit checksum field value, in host order.
+inline unsigned short checksum_finish(std::uint64_t sum) noexcept {
+  while (sum >> 16) {
+    sum = (sum & 0xFFFF) + (sum >> 16);
+  }
+  auto folded = static_cast<std::uint16_t>(sum);
+  if constexpr (std::endian::native == std::endian::little) {
+    folded = static_cast<std::uint16_t>(folded << 8 | folded >> 8);
+  }
+  return static_cast<unsigned short>(~folded);
+}
+
+// The checksum of `bytes`. Over a message that already carries its
+// checksum this is 0 when the message is intact.
+inline unsigned short internet_checksum(
+    std::span<const std::byte> bytes) noexcept {
+  return checksum_finish(checksum_add(bytes));
+}
+
+// Patches a checksum after one 16-bit word of the message changed, without
+// touching the rest of it (RFC 1624, eqn. 3).
+constexpr unsigned short checksum_update(unsigned short checksum,
+                                         unsigned short old_word,
+                                         unsigned short new_word) noexcept {
+  std::uint32_t sum = static_cast<std::uint16_t>(~checksum) +
+                      static_cast<std::uint16_t>(~old_word) + new_word;
+  sum = (sum & 0xFFFF) + (sum >> 16);
+  sum = (sum & 0xFFFF) + (sum >> 16);
+  return static_cast<unsigned short>(~sum);
+}
+} // namespace net
+
+#endif // CHECKSUM_HPP
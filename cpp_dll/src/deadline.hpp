@@ -0,0 +1,61 @@
+#ifndef DEADLINE_HPP
+#define DEADLINE_HPP
+
+#include <asio.hpp>
+#include <asio/experimental/awaitable_operators.hpp>
+#include <chrono>
+#include <exception>
+#include <system_error>
+#include <utility>
+#include <variant>
+
+namespace net {
+namespace detail {
+// Completes with what `awaitable` returned or threw. Raced against a timer
+// with `||`, a failure then wins the race instead of being dropped while
+// the timer runs out.
+template <class T>
+asio::awaitable<std::variant<T, std::exception_ptr>>
+settle(asio::awaitable<T> awaitable) {
+  try {
+    co_return std::variant<T, std::exception_ptr>(
+        std::in_place_index<0>, co_await std::move(awaitable));
+  } catch (...) {
+    co_return std::variant<T, std::exception_ptr>(std::in_place_index<1>,
+                                                  std::current_exception());
+  }
+}
+
+// The value of a settled awaitable, or its exception rethrown.
+template <class T> T unsettle(std::variant<T, std::exception_ptr> outcome) {
+  if (outcome.index()) {
+    std::rethrow_exception(std::get<1>(outcome));
+  }
+  return std::get<0>(std::move(outcome));
+}
+} // namespace detail
+
+// Runs `awaitable` unless `deadline` passes first, in which case it is
+// cancelled, closing its sockets and timers on the way out, and timed_out
+// is thrown. An error from `awaitable` is thrown as soon as it happens. A
+// deadline of zero or less means none.
+template <class T, class Rep, class Period>
+asio::awaitable<T> with_deadline(asio::awaitable<T> awaitable,
+                                 std::chrono::duration<Rep, Period> deadline) {
+  using namespace asio::experimental::awaitable_operators;
+
+  if (deadline.count() <= 0) {
+    co_return co_await std::move(awaitable);
+  }
+  asio::steady_timer timer(co_await asio::this_coro::executor);
+  timer.expires_after(deadline);
+  auto result = co_await (detail::settle(std::move(awaitable)) ||
+                          timer.async_wait(asio::use_awaitable));
+  if (result.index()) {
+    throw std::system_error(std::make_error_code(std::errc::timed_out));
+  }
+  co_return detail::unsettle(std::get<0>(std::move(result)));
+}
+} // namespace net
+
+#endif // DEADLINE_HPP
@@ -0,0 +1,317 @@
+#ifndef DNS_CACHE_HPP
+#define DNS_CACHE_HPP
+
+#include <asio.hpp>
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <initializer_list>
+#include <mutex>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <system_error>
+#include <type_traits>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#include "dns_client.hpp"
+#include "icmp_utils.hpp"
+#include "metrics.hpp"
+
+namespace net {
+// The addresses a lookup asks for.
+enum class address_family { any, v4, v6 };
+
+struct dns_cache_stats {
+  std::uint64_t hits = 0;
+  std::uint64_t misses = 0;
+  std::size_t entries = 0;
+};
+
+// Process-wide cache of resolved names, shared by every probe. Each entry
+// expires after its own TTL. Names that do not exist are cached as well, for
+// a shorter time, so a typo is not sent to the resolver on every call.
+class dns_cache {
+public:
+  using clock = std::chrono::steady_clock;
+
+  // getaddrinfo does not report the records' TTLs, so answers are stored
+  // for these fixed times and shortened to the TTLs the name server gives
+  // once its answer arrives, see async_resolve_cached.
+  static constexpr clock::duration default_ttl = std::chrono::seconds(60);
+  static constexpr clock::duration negative_ttl = std::chrono::seconds(10);
+  static constexpr std::size_t max_entries = 4096;
+
+  struct answer {
+    std::vector<asio::ip::address> addresses;
+    std::error_code error;
+  };
+
+  static dns_cache &instance() {
+    static dns_cache cache;
+    return cache;
+  }
+
+  std::optional<answer> find(const std::string &host, address_family family) {
+    std::lock_guard lock(mutex_);
+    auto &table = tables_[static_cast<std::size_t>(family)];
+    auto it = table.find(host);
+    if (it != table.end()) {
+      if (clock::now() < it->second.expires_at) {
+        hits_.fetch_add(1, std::memory_order_relaxed);
+        return it->second.value;
+      }
+      table.erase(it);
+    }
+    misses_.fetch_add(1, std::memory_order_relaxed);
+    return std::nullopt;
+  }
+
+  void store(const std::string &host, address_family family, answer value,
+             clock::duration ttl) {
+    std::lock_guard lock(mutex_);
+    auto now = clock::now();
+    auto &table = tables_[static_cast<std::size_t>(family)];
+    if (table.size() >= max_entries && !table.contains(host)) {
+      std::erase_if(table,
+                    [now](const auto &item) {
+                      return item.second.expires_at <= now;
+                    });
+      if (table.size() >= max_entries) {
+        table.erase(table.begin());
+      }
+    }
+    table.insert_or_assign(host, entry{std::move(value), now + ttl});
+  }
+
+  // Makes the entry for `host` expire `ttl` from now, if it still holds
+  // `value` and would otherwise be kept longer.
+  void shorten(const std::string &host, address_family family,
+               const answer &value, clock::duration ttl) {
+    std::lock_guard lock(mutex_);
+    auto &table = tables_[static_cast<std::size_t>(family)];
+    auto it = table.find(host);
+    if (it == table.end() || it->second.value.error != value.error ||
+        it->second.value.addresses != value.addresses) {
+      return;
+    }
+    it->second.expires_at = std::min(it->second.expires_at, clock::now() + ttl);
+  }
+
+  void clear() {
+    std::lock_guard lock(mutex_);
+    for (auto &table : tables_) {
+      table.clear();
+    }
+  }
+
+  dns_cache_stats stats() const {
+    dns_cache_stats stats{hits_.load(std::memory_order_relaxed),
+                          misses_.load(std::memory_order_relaxed), 0};
+    std::lock_guard lock(mutex_);
+    for (const auto &table : tables_) {
+      stats.entries += table.size();
+    }
+    return stats;
+  }
+
+private:
+  struct entry {
+    answer value;
+    clock::time_point expires_at;
+  };
+
+  dns_cache() = default;
+
+  mutable std::mutex mutex_;
+  std::array<std::unordered_map<std::string, entry>, 3> tables_;
+  std::atomic<std::uint64_t> hits_{0};
+  std::atomic<std::uint64_t> misses_{0};
+};
+
+namespace detail {
+// How long the name server is given to report the TTLs of a cached answer.
+constexpr std::chrono::seconds ttl_lookup_timeout{1};
+
+// The names /etc/hosts maps, in lower case. The file is read once, when the
+// module is imported.
+inline const std::unordered_set<std::string> &hosts_file_names() {
+  static const auto names = [] {
+    std::unordered_set<std::string> names;
+    std::ifstream hosts("/etc/hosts");
+    std::string line;
+    while (std::getline(hosts, line)) {
+      std::istringstream fields(line.substr(0, line.find('#')));
+      std::string name;
+      fields >> name;
+      while (fields >> name) {
+        std::ranges::transform(name, name.begin(), [](unsigned char c) {
+          return static_cast<char>(std::tolower(c));
+        });
+        names.insert(std::move(name));
+      }
+    }
+    return names;
+  }();
+  return names;
+}
+
+// Whether the name server may be asked about `host` for its TTLs. Names
+// without a dot are left out, since getaddrinfo completes them with the
+// search domains, and so are names the hosts file maps: neither is ever
+// sent upstream by the C library as it is.
+inline bool ask_server_for_ttls(std::string host) {
+  if (host.ends_with('.')) {
+    host.pop_back();
+  }
+  std::ranges::transform(host, host.begin(), [](unsigned char c) {
+    return static_cast<char>(std::tolower(c));
+  });
+  return host.find('.') != std::string::npos &&
+         !hosts_file_names().contains(host);
+}
+
+// How long to keep `answer`: the lowest TTL the name server gave for its
+// addresses or, for a name that does not exist, the negative TTL from the
+// zone's SOA, each capped at the fixed time. Zero means not at all.
+inline dns_cache::clock::duration cache_ttl(const dns_cache::answer &answer,
+                                            address_family family,
+                                            const dns_lookup &lookup) {
+  const auto fixed =
+      answer.error ? dns_cache::negative_ttl : dns_cache::default_ttl;
+  auto ttl = std::chrono::duration_cast<std::chrono::seconds>(fixed);
+  if (answer.error) {
+    for (auto [server_family, server_answer] :
+         {std::pair{address_family::v4, &lookup.v4},
+          std::pair{address_family::v6, &lookup.v6}}) {
+      if (family != address_family::any && family != server_family) {
+        continue;
+      }
+      if (server_answer->error != asio::error::host_not_found &&
+          server_answer->error != asio::error::no_data) {
+        return fixed;
+      }
+      ttl = std::min(ttl, server_answer->ttl);
+    }
+  } else {
+    for (const auto &address : answer.addresses) {
+      const auto &server_answer = address.is_v4() ? lookup.v4 : lookup.v6;
+      if (std::find(server_answer.addresses.begin(),
+                    server_answer.addresses.end(),
+                    address) == server_answer.addresses.end()) {
+        return fixed;
+      }
+      ttl = std::min(ttl, server_answer.ttl);
+    }
+  }
+  return ttl;
+}
+
+// Shortens the cached `answer` of `host` to the TTLs the name server gives
+// for it. It runs detached and owns all it uses; when the server does not
+// answer in time, the fixed TTL stays.
+inline asio::awaitable<void> refine_cached_ttl(std::string host,
+                                               address_family family,
+                                               dns_cache::answer answer) {
+  dns_lookup lookup;
+  try {
+    lookup = co_await async_dns_lookup(host, default_name_server(),
+                                       ttl_lookup_timeout);
+  } catch (const std::system_error &) {
+    co_return;
+  }
+  dns_cache::instance().shorten(host, family, answer,
+                                cache_ttl(answer, family, lookup));
+}
+} // namespace detail
+
+// Reads /etc/resolv.conf and /etc/hosts, which lookups read only once, so
+// that it happens on the calling thread rather than on an engine thread.
+inline void load_resolver_files() {
+  default_name_server();
+  detail::hosts_file_names();
+}
+
+// Resolves `host` without blocking the reactor, answering from the shared
+// cache when it can. Literal addresses skip both. Throws std::system_error
+// when the name does not resolve, whether the failure is fresh or cached.
+inline asio::awaitable<std::vector<asio::ip::address>>
+async_resolve_cached(std::string host,
+                     address_family family = address_family::any) {
+  std::error_code ec;
+  auto literal = asio::ip::make_address(host, ec);
+  if (!ec && (family == address_family::any ||
+              literal.is_v4() == (family == address_family::v4))) {
+    co_return std::vector<asio::ip::address>{literal};
+  }
+
+  auto &cache = dns_cache::instance();
+  auto cached = cache.find(host, family);
+  if (!cached) {
+    auto executor = co_await asio::this_coro::executor;
+    asio::ip::udp::resolver resolver(executor);
+    asio::ip::udp::resolver::results_type results;
+    auto started = std::chrono::steady_clock::now();
+    ec = {};
+    // getaddrinfo has the final say, as it also reads the hosts file and the
+    // search domains; the name server is only asked for the TTLs later.
+    if (family == address_family::any) {
+      results = co_await resolver.async_resolve(
+          host, "", asio::redirect_error(asio::use_awaitable, ec));
+    } else {
+      results = co_await resolver.async_resolve(
+          family == address_family::v4 ? asio::ip::udp::v4()
+                                       : asio::ip::udp::v6(),
+          host, "", asio::redirect_error(asio::use_awaitable, ec));
+    }
+    module_metrics::instance()
+        .stage(probe_stage::resolve)
+        .record(std::chrono::steady_clock::now() - started);
+
+    dns_cache::answer answer;
+    for (const auto &result : results) {
+      auto address = result.endpoint().address();
+      if (std::find(answer.addresses.begin(), answer.addresses.end(),
+                    address) == answer.addresses.end()) {
+        answer.addresses.push_back(address);
+      }
+    }
+    if (!ec && answer.addresses.empty()) {
+      ec = asio::error::host_not_found;
+    }
+    answer.error = ec;
+    // A temporary failure or a cancelled lookup says nothing about the name.
+    if (ec != asio::error::host_not_found_try_again &&
+        ec != asio::error::operation_aborted) {
+      cache.store(host, family, answer,
+                  ec ? dns_cache::negative_ttl : dns_cache::default_ttl);
+      if (detail::ask_server_for_ttls(host)) {
+        asio::co_spawn(executor,
+                       detail::refine_cached_ttl(host, family, answer),
+                       asio::detached);
+      }
+    }
+    cached = std::move(answer);
+  }
+  if (cached->error) {
+    throw std::system_error(cached->error);
+  }
+  co_return std::move(cached->addresses);
+}
+
+// The family an IP token probes.
+template <class IPType> constexpr address_family address_family_of() noexcept {
+  return std::is_same_v<IPType, use_ipv4_t> ? address_family::v4
+                                            : address_family::v6;
+}
+} // namespace net
+
+#endif // DNS_CACHE_HPP
@@ -0,0 +1,256 @@
+#ifndef DNS_CLIENT_HPP
+#define DNS_CLIENT_HPP
+
+#include <asio.hpp>
+#include <asio/experimental/awaitable_operators.hpp>
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <fstream>
+#include <optional>
+#include <random>
+#include <span>
+#include <sstream>
+#include <string>
+#include <system_error>
+#include <vector>
+
+#include "deadline.hpp"
+#include "dns_message.hpp"
+#include "join.hpp"
+
+namespace net {
+struct dns_answer {
+  std::vector<asio::ip::address> addresses;
+  std::error_code error;
+  std::chrono::seconds ttl{0};
+};
+
+struct dns_lookup {
+  dns_answer v4;
+  dns_answer v6;
+};
+
+namespace detail {
+inline asio::ip::udp::endpoint read_name_server() {
+  std::ifstream config("/etc/resolv.conf");
+  std::string line;
+  while (std::getline(config, line)) {
+    std::istringstream fields(line);
+    std::string keyword;
+    std::string address;
+    if (fields >> keyword >> address && keyword == "nameserver") {
+      std::error_code ec;
+      auto parsed = asio::ip::make_address(address, ec);
+      if (!ec) {
+        return {parsed, 53};
+      }
+    }
+  }
+  return {asio::ip::address_v4::loopback(), 53};
+}
+} // namespace detail
+
+// The first name server in /etc/resolv.conf or, like the C library, the
+// local host when there is none. The file is read once, when the module is
+// imported, so no lookup reads it on an engine thread.
+inline const asio::ip::udp::endpoint &default_name_server() {
+  static const asio::ip::udp::endpoint server = detail::read_name_server();
+  return server;
+}
+
+namespace detail {
+struct dns_query {
+  dns_type type;
+  std::vector<unsigned char> message;
+  std::optional<dns_response> response;
+  // Why there is no response, when it is not a timeout.
+  std::error_code error;
+};
+
+inline unsigned short dns_transaction_id() {
+  thread_local std::mt19937 engine(std::random_device{}());
+  return static_cast<unsigned short>(engine());
+}
+
+inline dns_answer to_dns_answer(const dns_query &query) {
+  dns_answer answer;
+  const auto &response = query.response;
+  if (!response) {
+    answer.error = query.error ? query.error : asio::error::timed_out;
+    return answer;
+  }
+  answer.addresses = response->addresses;
+  answer.ttl = std::chrono::seconds(response->ttl);
+  switch (response->rcode) {
+  case 0:
+    if (answer.addresses.empty()) {
+      answer.error = asio::error::no_data;
+    }
+    break;
+  case 2:
+    answer.error = asio::error::host_not_found_try_again;
+    break;
+  case 3:
+    answer.error = asio::error::host_not_found;
+    break;
+  default:
+    answer.error = asio::error::no_recovery;
+    break;
+  }
+  return answer;
+}
+
+// Asks `query` again over TCP, for answers that did not fit a datagram.
+inline asio::awaitable<std::vector<unsigned char>>
+dns_exchange_tcp(const asio::ip::udp::endpoint &server,
+                 std::span<const unsigned char> query,
+                 std::chrono::steady_clock::time_point deadline) {
+  using namespace asio::experimental::awaitable_operators;
+
+  auto executor = co_await asio::this_coro::executor;
+  asio::ip::tcp::socket socket(executor);
+  asio::steady_timer timer(executor);
+  timer.expires_at(deadline);
+
+  auto exchange = [&]() -> asio::awaitable<std::vector<unsigned char>> {
+    co_await socket.async_connect({server.address(), server.port()},
+                                  asio::use_awaitable);
+    std::array<unsigned char, 2> prefix{
+        static_cast<unsigned char>(query.size() >> 8),
+        static_cast<unsigned char>(query.size() & 0xFF)};
+    std::array<asio::const_buffer, 2> buffers{
+        asio::buffer(prefix), asio::buffer(query.data(), query.size())};
+    co_await asio::async_write(socket, buffers, asio::use_awaitable);
+    co_await asio::async_read(socket, asio::buffer(prefix),
+                              asio::use_awaitable);
+    std::vector<unsigned char> response(
+        static_cast<std::size_t>(prefix[0] << 8 | prefix[1]));
+    co_await asio::async_read(socket, asio::buffer(response),
+                              asio::use_awaitable);
+    co_return response;
+  };
+
+  // A refused or reset connection fails at once with its own error instead
+  // of waiting for the timer.
+  auto result = co_await (settle(exchange()) ||
+                          timer.async_wait(asio::use_awaitable));
+  if (result.index()) {
+    throw std::system_error(std::make_error_code(std::errc::timed_out));
+  }
+  co_return unsettle(std::get<0>(std::move(result)));
+}
+} // namespace detail
+
+// Looks up the A and AAAA records of `host` at `server`. Both queries go out
+// at once on one socket and responses are matched by transaction ID and
+// question; queries still unanswered halfway to the timeout are sent again.
+// Truncated answers are asked for again over TCP, both at once and within
+// the same timeout.
+template <class Rep, class Period>
+inline asio::awaitable<dns_lookup>
+async_dns_lookup(std::string host, asio::ip::udp::endpoint server,
+                 std::chrono::duration<Rep, Period> timeout) {
+  using namespace asio::experimental::awaitable_operators;
+  using clock = std::chrono::steady_clock;
+
+  auto executor = co_await asio::this_coro::executor;
+  std::array<detail::dns_query, 2> queries{
+      detail::dns_query{dns_type::a}, detail::dns_query{dns_type::aaaa}};
+  auto id = detail::dns_transaction_id();
+  for (auto &query : queries) {
+    if (!encode_dns_query(query.message, id++, host, query.type)) {
+      throw std::system_error(
+          std::make_error_code(std::errc::invalid_argument));
+    }
+  }
+
+  // Connecting makes the kernel drop datagrams from anyone but the server.
+  asio::ip::udp::socket socket(executor, server.protocol());
+  socket.connect(server);
+
+  auto send_pending = [&] {
+    for (const auto &query : queries) {
+      if (!query.response) {
+        std::error_code ec;
+        socket.send(asio::buffer(query.message), 0, ec);
+      }
+    }
+  };
+  auto pending = [&] {
+    return !queries[0].response || !queries[1].response;
+  };
+
+  const auto start = clock::now();
+  const auto deadline = start + timeout;
+  const auto resend_at = start + timeout / 2;
+  bool resent = false;
+  std::array<unsigned char, 4096> buffer;
+  asio::steady_timer timer(executor);
+  send_pending();
+  while (pending()) {
+    auto now = clock::now();
+    if (now >= deadline) {
+      break;
+    }
+    if (!resent && now >= resend_at) {
+      send_pending();
+      resent = true;
+    }
+    timer.expires_at(resent ? deadline : resend_at);
+
+    std::error_code ec;
+    auto result = co_await (
+        socket.async_receive(asio::buffer(buffer),
+                             asio::redirect_error(asio::use_awaitable, ec)) ||
+        timer.async_wait(asio::use_awaitable));
+    if (result.index()) {
+      continue;
+    }
+    if (ec) {
+      // Typically connection_refused: nothing listens at the server.
+      for (auto &query : queries) {
+        query.error = ec;
+      }
+      break;
+    }
+    auto message = std::span<const unsigned char>(buffer).first(
+        std::get<0>(result));
+    for (auto &query : queries) {
+      dns_response response;
+      if (!query.response &&
+          decode_dns_response(message, query.message, response)) {
+        query.response = std::move(response);
+      }
+    }
+  }
+
+  auto retry_over_tcp = [&](detail::dns_query &query) -> asio::awaitable<void> {
+    dns_response response;
+    try {
+      auto message =
+          co_await detail::dns_exchange_tcp(server, query.message, deadline);
+      if (decode_dns_response(message, query.message, response) &&
+          !response.truncated) {
+        query.response = std::move(response);
+        co_return;
+      }
+    } catch (const std::system_error &e) {
+      query.error = e.code();
+    }
+    query.response.reset();
+  };
+  std::vector<asio::awaitable<void>> retries;
+  for (auto &query : queries) {
+    if (query.response && query.response->truncated) {
+      retries.push_back(retry_over_tcp(query));
+    }
+  }
+  co_await join_all(std::move(retries));
+
+  co_return dns_lookup{detail::to_dns_answer(queries[0]),
+                       detail::to_dns_answer(queries[1])};
+}
+} // namespace net
+
+#endif // DNS_CLIENT_HPP
@@ -0,0 +1,175 @@
+#ifndef DNS_MESSAGE_HPP
+#define DNS_MESSAGE_HPP
+
+#include <asio/ip/address.hpp>
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string_view>
+#include <vector>
+
+// Just enough of the DNS wire format (RFC 1035) to ask a recursive resolver
+// for the A or AAAA records of one name and read its answer.
+
+namespace net {
+enum class dns_type : unsigned short { a = 1, aaaa = 28 };
+
+// What a response says about the question it answers.
+struct dns_response {
+  bool truncated = false;
+  unsigned char rcode = 0;
+  std::vector<asio::ip::address> addresses;
+  // The lowest TTL of the records that led to the addresses or, for a
+  // negative answer, the one derived from the zone's SOA (RFC 2308).
+  std::uint32_t ttl = 0;
+};
+
+namespace detail {
+constexpr unsigned short dns_class_in = 1;
+constexpr unsigned short dns_type_cname = 5;
+constexpr unsigned short dns_type_soa = 6;
+
+inline unsigned short dns_word(std::span<const unsigned char> message,
+                               std::size_t offset) noexcept {
+  return static_cast<unsigned short>(message[offset] << 8 |
+                                     message[offset + 1]);
+}
+
+inline std::uint32_t dns_long(std::span<const unsigned char> message,
+                              std::size_t offset) noexcept {
+  return static_cast<std::uint32_t>(dns_word(message, offset)) << 16 |
+         dns_word(message, offset + 2);
+}
+
+// Steps over a possibly compressed name. Returns false when it runs off the
+// end of the message.
+inline bool skip_dns_name(std::span<const unsigned char> message,
+                          std::size_t &offset) noexcept {
+  while (offset < message.size()) {
+    unsigned char length = message[offset];
+    if ((length & 0xC0) == 0xC0) {
+      offset += 2;
+      return offset <= message.size();
+    }
+    if (length & 0xC0) {
+      return false;
+    }
+    offset += 1 + length;
+    if (length == 0) {
+      return true;
+    }
+  }
+  return false;
+}
+} // namespace detail
+
+// Writes a recursive query for `name` into `out`. Returns false when the
+// name cannot be encoded.
+inline bool encode_dns_query(std::vector<unsigned char> &out,
+                             unsigned short id, std::string_view name,
+                             dns_type type) {
+  if (name.ends_with('.')) {
+    name.remove_suffix(1);
+  }
+  if (name.empty()) {
+    return false;
+  }
+  out.assign({static_cast<unsigned char>(id >> 8),
+              static_cast<unsigned char>(id & 0xFF), 0x01, 0x00, 0, 1, 0, 0,
+              0, 0, 0, 0});
+  while (!name.empty()) {
+    auto label = name.substr(0, name.find('.'));
+    if (label.empty() || label.size() > 63) {
+      return false;
+    }
+    out.push_back(static_cast<unsigned char>(label.size()));
+    out.insert(out.end(), label.begin(), label.end());
+    name.remove_prefix(std::min(name.size(), label.size() + 1));
+  }
+  out.push_back(0);
+  if (out.size() - 12 > 255) {
+    return false;
+  }
+  auto code = static_cast<unsigned short>(type);
+  out.insert(out.end(), {static_cast<unsigned char>(code >> 8),
+                         static_cast<unsigned char>(code & 0xFF), 0,
+                         detail::dns_class_in});
+  return true;
+}
+
+// Reads the response to `query`. Returns false when `message` is malformed
+// or answers some other question.
+inline bool decode_dns_response(std::span<const unsigned char> message,
+                                std::span<const unsigned char> query,
+                                dns_response &response) {
+  if (message.size() < query.size() || query.size() < 12) {
+    return false;
+  }
+  auto flags = detail::dns_word(message, 2);
+  if (detail::dns_word(message, 0) != detail::dns_word(query, 0) ||
+      !(flags & 0x8000) || detail::dns_word(message, 4) != 1 ||
+      !std::equal(query.begin() + 12, query.end(), message.begin() + 12)) {
+    return false;
+  }
+  response = {};
+  response.truncated = flags & 0x0200;
+  response.rcode = flags & 0x0F;
+  if (response.truncated) {
+    return true;
+  }
+
+  auto type = detail::dns_word(query, query.size() - 4);
+  auto answers = detail::dns_word(message, 6);
+  auto authorities = detail::dns_word(message, 8);
+  std::size_t offset = query.size();
+  std::uint32_t ttl = UINT32_MAX;
+  std::uint32_t negative_ttl = 0;
+  for (std::size_t i = 0; i < answers + authorities; ++i) {
+    if (!detail::skip_dns_name(message, offset) ||
+        message.size() - offset < 10) {
+      return false;
+    }
+    auto record_type = detail::dns_word(message, offset);
+    auto record_class = detail::dns_word(message, offset + 2);
+    auto record_ttl = detail::dns_long(message, offset + 4);
+    std::size_t length = detail::dns_word(message, offset + 8);
+    offset += 10;
+    if (message.size() - offset < length) {
+      return false;
+    }
+    auto data = message.subspan(offset, length);
+    offset += length;
+    if (record_class != detail::dns_class_in) {
+      continue;
+    }
+
+    if (i >= answers) {
+      // The SOA's last field is the zone's negative caching time.
+      if (record_type == detail::dns_type_soa && length >= 20) {
+        negative_ttl =
+            std::min(record_ttl, detail::dns_long(data, length - 4));
+      }
+    } else if (record_type == detail::dns_type_cname) {
+      ttl = std::min(ttl, record_ttl);
+    } else if (record_type != type) {
+      continue;
+    } else if (type == static_cast<unsigned short>(dns_type::a) &&
+               length == 4) {
+      response.addresses.push_back(asio::ip::address_v4(
+          {data[0], data[1], data[2], data[3]}));
+      ttl = std::min(ttl, record_ttl);
+    } else if (type == static_cast<unsigned short>(dns_type::aaaa) &&
+               length == 16) {
+      asio::ip::address_v6::bytes_type bytes;
+      std::copy(data.begin(), data.end(), bytes.begin());
+      response.addresses.push_back(asio::ip::address_v6(bytes));
+      ttl = std::min(ttl, record_ttl);
+    }
+  }
+  response.ttl = response.addresses.empty() ? negative_ttl : ttl;
+  return true;
+}
+} // namespace net
+
+#endif // DNS_MESSAGE_HPP
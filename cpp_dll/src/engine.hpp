@@ -0,0 +1,153 @@
+#ifndef ENGINE_HPP
+#define ENGINE_HPP
+
+#include <asio.hpp>
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace net {
+// Which of the engine's contexts an io_context is, for state that is split
+// between them. A context the engine did not make counts as the only one.
+class context_index : public asio::execution_context::service {
+public:
+  static inline asio::execution_context::id id;
+
+  explicit context_index(asio::execution_context &context,
+                         std::size_t index = 0, std::size_t count = 1)
+      : asio::execution_context::service(context), index_(index),
+        count_(count) {}
+
+  std::size_t index() const noexcept { return index_; }
+  std::size_t count() const noexcept { return count_; }
+
+private:
+  void shutdown() override {}
+
+  std::size_t index_;
+  std::size_t count_;
+};
+
+// Long-lived io_contexts, each driven by a background thread of its own.
+// Every probe in the module is spawned onto one of them instead of building
+// a reactor per call. An operation stays on the context it was spawned on,
+// which serializes it like a strand, and every context has its own ICMP
+// sockets (see icmp_dispatcher), so threads share neither sockets nor locks
+// on the probe path.
+class engine {
+public:
+  using executor_type = asio::io_context::executor_type;
+
+  // Contexts are made up front, one per core by default, but their threads
+  // only start once set_thread_count() asks for them.
+  explicit engine(
+      std::size_t thread_count = 1,
+      std::size_t max_threads = std::thread::hardware_concurrency()) {
+    max_threads = std::max<std::size_t>(max_threads, 1);
+    workers_.reserve(max_threads);
+    for (std::size_t i = 0; i < max_threads; ++i) {
+      workers_.push_back(std::make_unique<worker>());
+      asio::make_service<context_index>(workers_.back()->context, i,
+                                        max_threads);
+    }
+    set_thread_count(thread_count);
+  }
+
+  ~engine() noexcept { stop(); }
+
+  engine(const engine &) = delete;
+  engine &operator=(const engine &) = delete;
+
+  // Spreads operations spawned from now on over `count` threads, clamped to
+  // [1, max_threads()]. Threads left out finish what they already have.
+  void set_thread_count(std::size_t count) {
+    count = std::clamp<std::size_t>(count, 1, workers_.size());
+    std::lock_guard lock(mutex_);
+    if (stopped_) {
+      return;
+    }
+    for (std::size_t i = 0; i < count; ++i) {
+      auto &worker = *workers_[i];
+      if (!worker.thread.joinable()) {
+        worker.thread = std::thread([&worker] { worker.context.run(); });
+      }
+    }
+    active_.store(count, std::memory_order_release);
+  }
+
+  std::size_t thread_count() const noexcept {
+    return active_.load(std::memory_order_acquire);
+  }
+
+  std::size_t max_threads() const noexcept { return workers_.size(); }
+
+  // The next context in turn.
+  executor_type get_executor() noexcept {
+    auto count = active_.load(std::memory_order_acquire);
+    auto index = next_.fetch_add(1, std::memory_order_relaxed) % count;
+    return workers_[index]->context.get_executor();
+  }
+
+  // Calls `f` with every context, running or not.
+  template <class F> void for_each_context(F &&f) {
+    for (auto &worker : workers_) {
+      f(worker->context);
+    }
+  }
+
+  // Spawns the awaitable onto the engine and returns a future for its result.
+  template <class T> std::future<T> spawn(asio::awaitable<T> awaitable) {
+    return asio::co_spawn(get_executor(), std::move(awaitable),
+                          asio::use_future);
+  }
+
+  void stop() noexcept {
+    std::lock_guard lock(mutex_);
+    stopped_ = true;
+    for (auto &worker : workers_) {
+      worker->work_guard.reset();
+      worker->context.stop();
+    }
+    for (auto &worker : workers_) {
+      auto &thread = worker->thread;
+      if (!thread.joinable()) {
+        continue;
+      }
+      if (thread.get_id() == std::this_thread::get_id()) {
+        thread.detach();
+      } else {
+        thread.join();
+      }
+    }
+  }
+
+  static engine &instance() {
+    static engine instance;
+    return instance;
+  }
+
+private:
+  struct worker {
+    // Only ever run by one thread, which lets asio skip some locking.
+    asio::io_context context{1};
+    asio::executor_work_guard<executor_type> work_guard =
+        asio::make_work_guard(context);
+    std::thread thread;
+  };
+
+  std::vector<std::unique_ptr<worker>> workers_;
+  std::atomic<std::size_t> active_{0};
+  std::atomic<std::size_t> next_{0};
+  std::mutex mutex_;
+  bool stopped_ = false;
+};
+} // namespace net
+
+#endif // ENGINE_HPP
@@ -0,0 +1,142 @@
+#ifndef HEADER_VIEW_HPP
+#define HEADER_VIEW_HPP
+
+#include <asio/ip/address_v4.hpp>
+#include <asio/ip/address_v6.hpp>
+#include <cstddef>
+#include <span>
+
+// Non-owning views of the headers inside a received packet. Fields are read
+// in place from the packet's bytes, so decoding a reply copies nothing until
+// the caller decides to keep it. Check valid() before reading any field.
+
+namespace net {
+namespace detail {
+class byte_reader {
+public:
+  explicit byte_reader(std::span<const std::byte> bytes) noexcept
+      : bytes_(bytes) {}
+
+  std::size_t available() const noexcept { return bytes_.size(); }
+
+  unsigned char byte(std::size_t i) const noexcept {
+    return std::to_integer<unsigned char>(bytes_[i]);
+  }
+
+  unsigned short word(std::size_t i) const noexcept {
+    return static_cast<unsigned short>(byte(i) << 8 | byte(i + 1));
+  }
+
+  std::span<const std::byte> first(std::size_t n) const noexcept {
+    return bytes_.first(n);
+  }
+
+  std::span<const std::byte> after(std::size_t n) const noexcept {
+    return bytes_.subspan(n);
+  }
+
+private:
+  std::span<const std::byte> bytes_;
+};
+} // namespace detail
+
+class icmp_header_view {
+public:
+  static constexpr std::size_t header_size = 8;
+
+  explicit icmp_header_view(std::span<const std::byte> bytes) noexcept
+      : reader_(bytes) {}
+
+  bool valid() const noexcept { return reader_.available() >= header_size; }
+
+  unsigned char type() const noexcept { return reader_.byte(0); }
+  unsigned char code() const noexcept { return reader_.byte(1); }
+  unsigned short checksum() const noexcept { return reader_.word(2); }
+  unsigned short identifier() const noexcept { return reader_.word(4); }
+  unsigned short sequence_number() const noexcept { return reader_.word(6); }
+
+  std::span<const std::byte> bytes() const noexcept {
+    return reader_.first(header_size);
+  }
+
+  // The echo data, or for errors the packet being quoted.
+  std::span<const std::byte> payload() const noexcept {
+    return reader_.after(header_size);
+  }
+
+private:
+  detail::byte_reader reader_;
+};
+
+class ipv4_header_view {
+public:
+  explicit ipv4_header_view(std::span<const std::byte> bytes) noexcept
+      : reader_(bytes) {}
+
+  bool valid() const noexcept {
+    return reader_.available() >= 20 && version() == 4 &&
+           header_length() >= 20 && reader_.available() >= header_length();
+  }
+
+  unsigned char version() const noexcept { return reader_.byte(0) >> 4; }
+  unsigned short header_length() const noexcept {
+    return (reader_.byte(0) & 0xF) * 4;
+  }
+  unsigned int time_to_live() const noexcept { return reader_.byte(8); }
+  unsigned char protocol() const noexcept { return reader_.byte(9); }
+
+  asio::ip::address_v4 source_address() const {
+    return asio::ip::address_v4(
+        {reader_.byte(12), reader_.byte(13), reader_.byte(14),
+         reader_.byte(15)});
+  }
+
+  std::span<const std::byte> bytes() const noexcept {
+    return reader_.first(header_length());
+  }
+
+  std::span<const std::byte> payload() const noexcept {
+    return reader_.after(header_length());
+  }
+
+private:
+  detail::byte_reader reader_;
+};
+
+class ipv6_header_view {
+public:
+  static constexpr std::size_t header_size = 40;
+
+  explicit ipv6_header_view(std::span<const std::byte> bytes) noexcept
+      : reader_(bytes) {}
+
+  bool valid() const noexcept {
+    return reader_.available() >= header_size && version() == 6;
+  }
+
+  unsigned char version() const noexcept { return reader_.byte(0) >> 4; }
+  unsigned char next_header() const noexcept { return reader_.byte(6); }
+  unsigned int time_to_live() const noexcept { return reader_.byte(7); }
+
+  asio::ip::address_v6 source_address() const {
+    asio::ip::address_v6::bytes_type bytes;
+    for (std::size_t i = 0; i < bytes.size(); ++i) {
+      bytes[i] = reader_.byte(8 + i);
+    }
+    return asio::ip::address_v6(bytes);
+  }
+
+  std::span<const std::byte> bytes() const noexcept {
+    return reader_.first(header_size);
+  }
+
+  std::span<const std::byte> payload() const noexcept {
+    return reader_.after(header_size);
+  }
+
+private:
+  detail::byte_reader reader_;
+};
+} // namespace net
+
+#endif // HEADER_VIEW_HPP
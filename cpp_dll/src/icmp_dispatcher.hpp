@@ -0,0 +1,801 @@
+#ifndef ICMP_DISPATCHER_HPP
+#define ICMP_DISPATCHER_HPP
+
+#include <asio.hpp>
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <optional>
+#include <span>
+#include <system_error>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "engine.hpp"
+#include "icmp_header.hpp"
+#include "icmp_transport.hpp"
+#include "icmp_utils.hpp"
+#include "metrics.hpp"
+
+namespace net {
+template <class IPType> class icmp_dispatcher;
+
+// One echo request of a burst handed to send_batch.
+struct icmp_probe {
+  asio::const_buffer buffer;
+  asio::ip::icmp::endpoint destination;
+};
+
+#if defined(__linux__)
+namespace detail {
+// The sendmmsg headers of one burst and the buffers they point into.
+struct icmp_send_batch {
+  std::vector<mmsghdr> messages;
+  std::vector<std::array<iovec, 2>> iovs;
+  std::vector<std::array<unsigned char, 8>> headers;
+  std::vector<hop_limit_control> controls;
+  // The index of the probe each message carries.
+  std::vector<std::size_t> origins;
+};
+} // namespace detail
+#endif
+
+// Counters for comparing batched and per-packet I/O: packets per system
+// call in each direction.
+struct icmp_io_stats {
+  std::uint64_t packets_sent = 0;
+  std::uint64_t send_calls = 0;
+  std::uint64_t packets_received = 0;
+  std::uint64_t receive_calls = 0;
+};
+
+// A block of ICMP identifiers leased from the dispatcher. Replies carrying
+// one of them are queued here until the owning coroutine receives them.
+template <class IPType> class icmp_session {
+public:
+  using clock = std::chrono::steady_clock;
+
+  explicit icmp_session(const asio::any_io_executor &executor,
+                        std::size_t identifier_count = 1);
+  ~icmp_session();
+
+  icmp_session(const icmp_session &) = delete;
+  icmp_session &operator=(const icmp_session &) = delete;
+
+  unsigned short identifier(std::size_t index = 0) const noexcept {
+    return static_cast<unsigned short>(base_ + index);
+  }
+
+  std::size_t identifier_count() const noexcept { return count_; }
+
+  // Maps an identifier of this session back to its index in the block.
+  std::size_t index_of(unsigned short identifier) const noexcept {
+    return static_cast<unsigned short>(identifier - base_);
+  }
+
+  // Returns the time the probe left, see icmp_dispatcher::send_to. Only
+  // one send of a session may be in progress at a time.
+  asio::awaitable<clock::time_point>
+  send_to(asio::const_buffer buffer,
+          const asio::ip::icmp::endpoint &destination, int ttl,
+          std::error_code &ec);
+
+  // `ec` gets the error of the last probe that failed. When `errors` is
+  // given, one per probe, each also gets the error of its own probe and is
+  // left alone if that probe was sent.
+  asio::awaitable<clock::time_point>
+  send_batch(std::span<const icmp_probe> probes, int ttl,
+             std::error_code &ec, std::span<std::error_code> errors = {});
+
+  // Waits for the next reply routed to this session. Returns an empty
+  // optional once the deadline passes or wake() is called.
+  asio::awaitable<std::optional<icmp_reply<IPType>>>
+  receive(clock::time_point deadline) {
+    while (queued_ == 0) {
+      if (woken_) {
+        woken_ = false;
+        co_return std::nullopt;
+      }
+      if (clock::now() >= deadline) {
+        co_return std::nullopt;
+      }
+      signal_.expires_at(deadline);
+      std::error_code ec;
+      co_await signal_.async_wait(
+          asio::redirect_error(asio::use_awaitable, ec));
+    }
+    auto reply = std::move(queue_[head_]);
+    head_ = (head_ + 1) % queue_.size();
+    --queued_;
+    module_metrics::instance().icmp<IPType>().replies_queued.sub();
+    co_return reply;
+  }
+
+  // Makes the pending or next receive() return early, for a receiver that
+  // has to look at state other than replies.
+  void wake() {
+    woken_ = true;
+    signal_.cancel();
+  }
+
+private:
+  friend class icmp_dispatcher<IPType>;
+
+  void deliver(icmp_reply<IPType> &&reply) {
+    if (queued_ == queue_.size()) {
+      grow();
+    }
+    queue_[(head_ + queued_) % queue_.size()] = std::move(reply);
+    ++queued_;
+    module_metrics::instance().icmp<IPType>().replies_queued.add();
+    signal_.cancel();
+  }
+
+  // The queue is a ring that only reallocates when it is full, so a steady
+  // stream of replies does not allocate.
+  void grow() {
+    std::vector<icmp_reply<IPType>> larger(std::max<std::size_t>(
+        16, queue_.size() * 2));
+    for (std::size_t i = 0; i < queued_; ++i) {
+      larger[i] = std::move(queue_[(head_ + i) % queue_.size()]);
+    }
+    queue_ = std::move(larger);
+    head_ = 0;
+  }
+
+  icmp_dispatcher<IPType> &dispatcher_;
+  unsigned short base_ = 0;
+  std::size_t count_ = 0;
+  std::vector<icmp_reply<IPType>> queue_;
+  std::size_t head_ = 0;
+  std::size_t queued_ = 0;
+  // Tells this attachment from earlier sessions that held the same
+  // identifiers.
+  std::uint32_t lease_ = 0;
+  bool woken_ = false;
+  asio::steady_timer signal_;
+#if defined(__linux__)
+  // Kept per session rather than per dispatcher, since a send that waits
+  // for the socket lets other sessions send in between.
+  detail::icmp_send_batch batch_;
+#endif
+};
+
+// ICMP identifiers in use by any dispatcher of the process. Each engine
+// context leases from a partition of its own, see icmp_dispatcher, but
+// dispatchers of other io_contexts share the whole range, so a block is
+// only leased once it is free in all of them. One bit per identifier,
+// claimed with an atomic or, so leasing never takes a lock.
+template <class IPType> class identifier_leases {
+public:
+  static identifier_leases &instance() {
+    static identifier_leases leases;
+    return leases;
+  }
+
+  // Claims all of [base, base + count) or, if any is taken, none of them.
+  bool try_claim(unsigned short base, std::size_t count) noexcept {
+    for (std::size_t i = 0; i < count; ++i) {
+      auto identifier = static_cast<unsigned short>(base + i);
+      auto bit = std::uint64_t{1} << (identifier % 64);
+      if (words_[identifier / 64].fetch_or(bit, std::memory_order_acq_rel) &
+          bit) {
+        release(base, i);
+        return false;
+      }
+    }
+    return true;
+  }
+
+  void release(unsigned short base, std::size_t count) noexcept {
+    for (std::size_t i = 0; i < count; ++i) {
+      auto identifier = static_cast<unsigned short>(base + i);
+      auto bit = std::uint64_t{1} << (identifier % 64);
+      words_[identifier / 64].fetch_and(~bit, std::memory_order_release);
+    }
+  }
+
+private:
+  std::array<std::atomic<std::uint64_t>, 65536 / 64> words_{};
+};
+
+// One ICMP socket per address family and io_context. It reads every
+// packet once, decodes it once and routes it by identifier to the session
+// that owns it. Identifiers are only 16 bits wide, so the routing table is
+// a flat array indexed by identifier and every lookup is a single load.
+//
+// On Linux an unprivileged datagram socket is preferred when the system
+// allows one, see icmp_transport_preference(). The kernel then only delivers
+// replies to our own probes, but it also replaces every identifier with the
+// socket's, so each probe's sequence number is swapped for a slot that
+// remembers the session's identifier and sequence number.
+//
+// Each engine context leases identifiers from a disjoint partition of the
+// 16-bit space, and a raw socket gets an icmp_filter for exactly that
+// partition. The kernel then hands every thread only the replies to its own
+// probes instead of each raw socket reading and decoding all of them.
+template <class IPType>
+class icmp_dispatcher : public asio::execution_context::service {
+public:
+  using clock = std::chrono::steady_clock;
+
+  static inline asio::execution_context::id id;
+
+  explicit icmp_dispatcher(asio::execution_context &context)
+      : asio::execution_context::service(context), routes_(65536, nullptr) {
+    const auto &index = asio::use_service<context_index>(context);
+    partition_size_ = routes_.size() / index.count();
+    partition_first_ = index.index() * partition_size_;
+    next_offset_ = process_identifier() % partition_size_;
+  }
+
+  static icmp_dispatcher &get(const asio::any_io_executor &executor) {
+    return asio::use_service<icmp_dispatcher>(
+        asio::query(executor, asio::execution::context));
+  }
+
+  // Leases `count` consecutive free identifiers of this context's partition
+  // to the session.
+  unsigned short attach(icmp_session<IPType> &session, std::size_t count,
+                        const asio::any_io_executor &executor) {
+    if (count == 0 || count > partition_size_ - sessions_) {
+      throw std::system_error(
+          std::make_error_code(std::errc::resource_unavailable_try_again));
+    }
+    open_socket(executor);
+    auto &leases = identifier_leases<IPType>::instance();
+    auto offset = next_offset_;
+    for (std::size_t tried = 0; tried < partition_size_;
+         ++tried, offset = (offset + 1) % partition_size_) {
+      auto base = static_cast<unsigned short>(partition_first_ + offset);
+      if (offset + count > partition_size_ || !leases.try_claim(base, count)) {
+        continue;
+      }
+      for (std::size_t i = 0; i < count; ++i) {
+        routes_[base + i] = &session;
+      }
+      session.lease_ = ++leases_issued_;
+      next_offset_ = (offset + count) % partition_size_;
+      sessions_ += count;
+      start_receiving(executor);
+      return base;
+    }
+    throw std::system_error(
+        std::make_error_code(std::errc::resource_unavailable_try_again));
+  }
+
+  void detach(unsigned short base, std::size_t count) noexcept {
+    for (std::size_t i = 0; i < count; ++i) {
+      routes_[static_cast<unsigned short>(base + i)] = nullptr;
+    }
+    identifier_leases<IPType>::instance().release(base, count);
+    sessions_ -= count;
+    if (sessions_ == 0 && socket_) {
+      std::error_code ec;
+      socket_->cancel(ec);
+    }
+  }
+
+  // Sends the probe of `session` and returns the time taken right before
+  // the send, to be compared with the reply's received_at. It only waits
+  // while the socket's send buffer is full. On Linux the hop limit travels
+  // with the packet when the kernel allows; otherwise it is applied to the
+  // shared socket first.
+  asio::awaitable<clock::time_point>
+  send_to([[maybe_unused]] icmp_session<IPType> &session,
+          asio::const_buffer buffer,
+          const asio::ip::icmp::endpoint &destination, int ttl,
+          std::error_code &ec) {
+#if defined(__linux__)
+    icmp_probe probe{buffer, destination};
+    co_return co_await send_probes(session, std::span(&probe, 1), ttl, ec,
+                                   {});
+#else
+    if (!apply_ttl(ttl, ec)) {
+      co_return clock::now();
+    }
+    auto sent_at = clock::now();
+    co_await socket_->async_send_to(
+        buffer, destination, asio::redirect_error(asio::use_awaitable, ec));
+    count_sent(ec ? 0 : 1, 1, sent_at);
+    co_return sent_at;
+#endif
+  }
+
+  // Sends a burst of probes with one hop limit, in as few system calls as
+  // the platform allows: sendmmsg on Linux, one send_to each elsewhere.
+  // `errors` is empty or has one entry per probe, see
+  // icmp_session::send_batch.
+  asio::awaitable<clock::time_point>
+  send_batch(icmp_session<IPType> &session,
+             std::span<const icmp_probe> probes, int ttl, std::error_code &ec,
+             std::span<std::error_code> errors) {
+#if defined(__linux__)
+    if (icmp_batched_io().load(std::memory_order_relaxed)) {
+      co_return co_await send_probes(session, probes, ttl, ec, errors);
+    }
+#endif
+    auto sent_at = clock::now();
+    for (std::size_t i = 0; i < probes.size(); ++i) {
+      std::error_code probe_ec;
+      co_await send_to(session, probes[i].buffer, probes[i].destination, ttl,
+                       probe_ec);
+      if (probe_ec) {
+        ec = probe_ec;
+        if (!errors.empty()) {
+          errors[i] = probe_ec;
+        }
+      }
+    }
+    co_return sent_at;
+  }
+
+  // The transport of the open socket; raw until one is opened.
+  icmp_transport transport() const noexcept { return transport_; }
+
+  // Packets read from the socket, i.e. the ones no filter dropped.
+  std::uint64_t packets_received() const noexcept {
+    return packets_received_.load(std::memory_order_relaxed);
+  }
+
+  icmp_io_stats io_stats() const noexcept {
+    return {packets_sent_.load(std::memory_order_relaxed),
+            send_calls_.load(std::memory_order_relaxed),
+            packets_received_.load(std::memory_order_relaxed),
+            receive_calls_.load(std::memory_order_relaxed)};
+  }
+
+private:
+  struct probe_slot {
+    unsigned short identifier = 0;
+    unsigned short sequence_number = 0;
+    // The lease of the session that sent the probe, see icmp_session::lease_.
+    std::uint32_t lease = 0;
+  };
+
+  // How a probe gets its hop limit: as a control message sent with the
+  // packet when the kernel accepts one, else as a socket option set before
+  // the send whenever it changes. Decided once, when the socket is opened.
+  enum class hop_limit_mode { control, socket_option };
+
+  void shutdown() override { socket_.reset(); }
+
+#if defined(__linux__)
+  // Slots are claimed and messages built once; when the send buffer fills
+  // up, the rest goes out once the socket is writable again.
+  asio::awaitable<clock::time_point>
+  send_probes(icmp_session<IPType> &session,
+              std::span<const icmp_probe> probes, int ttl,
+              std::error_code &ec, std::span<std::error_code> errors) {
+    auto fail = [&](std::size_t probe, std::error_code error) {
+      ec = error;
+      if (!errors.empty()) {
+        errors[probe] = error;
+      }
+    };
+    const bool by_control = hop_limit_mode_ == hop_limit_mode::control;
+    if (std::error_code ttl_ec; !by_control && !apply_ttl(ttl, ttl_ec)) {
+      for (std::size_t i = 0; i < probes.size(); ++i) {
+        fail(i, ttl_ec);
+      }
+      co_return clock::now();
+    }
+    auto &batch = session.batch_;
+    batch.messages.clear();
+    batch.origins.clear();
+    batch.iovs.resize(probes.size());
+    batch.headers.resize(probes.size());
+    batch.controls.resize(probes.size());
+    for (std::size_t i = 0; i < probes.size(); ++i) {
+      const auto &probe = probes[i];
+      auto &iov = batch.iovs[i];
+      mmsghdr message{};
+      message.msg_hdr.msg_name =
+          const_cast<asio::ip::icmp::endpoint::data_type *>(
+              probe.destination.data());
+      message.msg_hdr.msg_namelen =
+          static_cast<socklen_t>(probe.destination.size());
+      message.msg_hdr.msg_iov = iov.data();
+      if (transport_ == icmp_transport::raw) {
+        iov[0] = {const_cast<void *>(probe.buffer.data()),
+                  probe.buffer.size()};
+        message.msg_hdr.msg_iovlen = 1;
+      } else {
+        // The kernel fills in the identifier and the checksum.
+        auto &header = batch.headers[i];
+        if (std::error_code claim_ec;
+            !claim_slot(probe.buffer, header, claim_ec)) {
+          fail(i, claim_ec);
+          continue;
+        }
+        iov[0] = {header.data(), header.size()};
+        iov[1] = {const_cast<char *>(
+                      static_cast<const char *>(probe.buffer.data()) +
+                      header.size()),
+                  probe.buffer.size() - header.size()};
+        message.msg_hdr.msg_iovlen = 2;
+      }
+      if (by_control) {
+        detail::set_hop_limit<IPType>(message.msg_hdr, batch.controls[i],
+                                      ttl);
+      }
+      batch.messages.push_back(message);
+      batch.origins.push_back(i);
+    }
+
+    auto sent_at = clock::now();
+    std::size_t accepted = 0;
+    std::size_t calls = 0;
+    // Messages [next, size) are still to send.
+    std::size_t next = 0;
+    while (next < batch.messages.size()) {
+      auto attempted_at = clock::now();
+      auto progress = send_messages(
+          *socket_, std::span(batch.messages).subspan(next),
+          [&](std::size_t message, std::error_code error) {
+            fail(batch.origins[next + message], error);
+          });
+      if (accepted == 0 && progress.accepted != 0) {
+        sent_at = attempted_at;
+      }
+      accepted += progress.accepted;
+      calls += progress.calls;
+      next += progress.consumed;
+      if (!progress.would_block) {
+        break;
+      }
+      std::error_code wait_ec;
+      co_await socket_->async_wait(
+          asio::socket_base::wait_write,
+          asio::redirect_error(asio::use_awaitable, wait_ec));
+      // Other sessions may have changed the hop limit in the meantime.
+      if (!wait_ec && !by_control) {
+        apply_ttl(ttl, wait_ec);
+      }
+      if (wait_ec) {
+        for (; next < batch.messages.size(); ++next) {
+          fail(batch.origins[next], wait_ec);
+        }
+      }
+    }
+    count_sent(accepted, calls, sent_at);
+    co_return sent_at;
+  }
+#endif
+
+  bool apply_ttl(int ttl, std::error_code &ec) {
+    if (ttl != current_ttl_) {
+      socket_->set_option(asio::ip::unicast::hops(ttl), ec);
+      if (ec) {
+        return false;
+      }
+      current_ttl_ = ttl;
+    }
+    return true;
+  }
+
+  // Copies the probe's ICMP header into `header` with its sequence number
+  // swapped for a fresh slot, for the datagram transport. Slots wrap around,
+  // so one still held by another session that is attached is skipped;
+  // reusing it would hand that session's late replies to this one.
+  bool claim_slot(asio::const_buffer buffer,
+                  std::array<unsigned char, 8> &header, std::error_code &ec) {
+    if (buffer.size() < header.size()) {
+      ec = asio::error::invalid_argument;
+      return false;
+    }
+    std::memcpy(header.data(), buffer.data(), header.size());
+    auto identifier = static_cast<unsigned short>(header[4] << 8 | header[5]);
+    auto owner = routes_[identifier];
+    for (std::size_t tried = 0; tried < slots_.size(); ++tried) {
+      auto slot = next_slot_++;
+      auto &held = slots_[slot];
+      if (held_by_other(held, owner)) {
+        continue;
+      }
+      held = {identifier,
+              static_cast<unsigned short>(header[6] << 8 | header[7]),
+              owner ? owner->lease_ : 0};
+      header[6] = static_cast<unsigned char>(slot >> 8);
+      header[7] = static_cast<unsigned char>(slot & 0xFF);
+      return true;
+    }
+    ec = asio::error::no_buffer_space;
+    return false;
+  }
+
+  // Whether `slot` belongs to an attached session other than `session`.
+  bool held_by_other(const probe_slot &slot,
+                     const icmp_session<IPType> *session) const noexcept {
+    auto holder = routes_[slot.identifier];
+    return holder && holder->lease_ == slot.lease && holder != session;
+  }
+
+  // `packets` is how many the kernel accepted in `calls` system calls, and
+  // `sent_at` is when the first call began. A send that failed outright is
+  // neither counted nor timed.
+  void count_sent(std::size_t packets, std::size_t calls,
+                  clock::time_point sent_at) noexcept {
+    if (packets == 0) {
+      return;
+    }
+    send_calls_.fetch_add(calls, std::memory_order_relaxed);
+    auto &metrics = module_metrics::instance();
+    metrics.stage(probe_stage::send).record(clock::now() - sent_at);
+    metrics.icmp<IPType>().probes_sent.add(packets);
+    packets_sent_.fetch_add(packets, std::memory_order_relaxed);
+  }
+
+  void open_socket(const asio::any_io_executor &executor) {
+    if (socket_) {
+      return;
+    }
+    auto preference =
+        icmp_transport_preference().load(std::memory_order_relaxed);
+    asio::ip::icmp::socket socket(executor);
+#if defined(__linux__)
+    if (preference != icmp_transport::raw) {
+      std::error_code ec;
+      open_datagram_socket<IPType>(socket, ec);
+      if (!ec) {
+        slots_.resize(65536);
+        transport_ = icmp_transport::datagram;
+      } else if (preference == icmp_transport::datagram) {
+        throw std::system_error(ec);
+      }
+    }
+    if (transport_ != icmp_transport::datagram) {
+      socket.open(icmp_protocol<IPType>());
+      attach_filter(socket);
+    }
+#if defined(__linux__)
+    // Older kernels ignore control messages on IPv6 ping sockets instead of
+    // rejecting them, so the check cannot tell and the option is used.
+    const bool checkable = !(std::is_same_v<IPType, use_ipv6_t> &&
+                             transport_ == icmp_transport::datagram);
+    hop_limit_mode_ =
+        checkable && detail::accepts_hop_limit_control<IPType>(socket)
+            ? hop_limit_mode::control
+            : hop_limit_mode::socket_option;
+#endif
+    if (icmp_kernel_timestamps().load(std::memory_order_relaxed)) {
+      // Without them replies are stamped when they are read.
+      std::error_code ec;
+      enable_kernel_timestamps(socket, ec);
+    }
+    // One slice per message of a recvmmsg batch, each large enough for the
+    // headers an error quotes.
+    receive_buffer_.resize(max_receive_batch * 4096);
+#else
+    if (preference == icmp_transport::datagram) {
+      throw std::system_error(
+          std::make_error_code(std::errc::operation_not_supported));
+    }
+    socket.open(icmp_protocol<IPType>());
+    receive_buffer_.resize(65536);
+#endif
+    socket_.emplace(std::move(socket));
+    module_metrics::instance().icmp<IPType>().sockets_opened.add();
+  }
+
+  // Keeps a raw socket to the replies for this context's partition.
+  void attach_filter(asio::ip::icmp::socket &socket) {
+#if defined(__linux__)
+    if (transport_ != icmp_transport::raw ||
+        !icmp_filter_enabled().load(std::memory_order_relaxed)) {
+      return;
+    }
+    // Without it the routing table still drops foreign replies.
+    std::error_code ec;
+    socket.set_option(
+        icmp_filter(IPType{},
+                    static_cast<unsigned short>(partition_first_),
+                    static_cast<unsigned short>(partition_first_ +
+                                                partition_size_ - 1)),
+        ec);
+#endif
+  }
+
+  void start_receiving(const asio::any_io_executor &executor) {
+    if (!receiving_) {
+      receiving_ = true;
+      asio::co_spawn(executor, receive_loop(), asio::detached);
+    }
+  }
+
+  asio::awaitable<void> receive_loop() {
+    while (sessions_ > 0 && socket_) {
+#if defined(__linux__)
+      // Read with recvmmsg so the TTL, queued errors and the kernel timestamp
+      // arrive along with each packet, and a burst of replies costs a single
+      // call per batch.
+      std::error_code ec;
+      co_await socket_->async_wait(
+          asio::socket_base::wait_read,
+          asio::redirect_error(asio::use_awaitable, ec));
+      if (ec == asio::error::operation_aborted) {
+        continue;
+      }
+      if (ec) {
+        break;
+      }
+      auto readable_at = clock::now();
+      std::size_t batch =
+          icmp_batched_io().load(std::memory_order_relaxed)
+              ? max_receive_batch
+              : 1;
+      std::size_t calls = 0;
+      if (transport_ == icmp_transport::datagram) {
+        calls = drain_datagram_socket<IPType>(
+            *socket_, receive_buffer_, batch,
+            [this](icmp_reply<IPType> &&reply) {
+              packets_received_.fetch_add(1, std::memory_order_relaxed);
+              route_slot(std::move(reply));
+            });
+      } else {
+        calls = drain_socket<IPType>(
+            *socket_, receive_buffer_, batch, 0,
+            [this](const received_message &received,
+                   std::span<const char> data) {
+              route_raw(std::as_bytes(data), detail::to_endpoint(received.from),
+                        received.length, received.received_at);
+            });
+      }
+      receive_calls_.fetch_add(calls, std::memory_order_relaxed);
+      module_metrics::instance()
+          .stage(probe_stage::receive)
+          .record(clock::now() - readable_at);
+#else
+      asio::ip::icmp::endpoint sender;
+      std::error_code ec;
+      std::size_t length = co_await socket_->async_receive_from(
+          asio::buffer(receive_buffer_), sender,
+          asio::redirect_error(asio::use_awaitable, ec));
+      if (ec == asio::error::operation_aborted) {
+        continue;
+      }
+      if (ec) {
+        break;
+      }
+      auto received_at = clock::now();
+      receive_calls_.fetch_add(1, std::memory_order_relaxed);
+      route_raw(std::as_bytes(std::span(receive_buffer_).first(length)),
+                sender, length, received_at);
+      module_metrics::instance()
+          .stage(probe_stage::receive)
+          .record(clock::now() - received_at);
+#endif
+    }
+    receiving_ = false;
+  }
+
+  void route_raw(std::span<const std::byte> packet,
+                 const asio::ip::icmp::endpoint &sender,
+                 std::size_t length, clock::time_point received_at) {
+    packets_received_.fetch_add(1, std::memory_order_relaxed);
+    decode_timer timer(*this);
+    auto &metrics = module_metrics::instance().icmp<IPType>();
+    icmp_reply<IPType> reply;
+    auto decoded =
+        decode_reply<IPType>(packet, sender, reply.ip_hdr, reply.icmp_hdr);
+    auto session = decoded == decode_result::reply
+                       ? routes_[reply.icmp_hdr.identifier()]
+                       : nullptr;
+    if (!session) {
+      if (decoded == decode_result::bad_checksum) {
+        metrics.checksum_failures.add();
+      }
+      metrics.replies_unmatched.add();
+      return;
+    }
+    reply.length = length;
+    reply.received_at = received_at;
+    session->deliver(std::move(reply));
+    metrics.replies_matched.add();
+  }
+
+  void route_slot(icmp_reply<IPType> &&reply) {
+    decode_timer timer(*this);
+    auto &metrics = module_metrics::instance().icmp<IPType>();
+    const auto &slot = slots_[reply.icmp_hdr.sequence_number()];
+    reply.icmp_hdr.identifier(slot.identifier);
+    reply.icmp_hdr.sequence_number(slot.sequence_number);
+    // A session that leased the identifier since the probe left is not the
+    // one waiting for it.
+    auto session = routes_[slot.identifier];
+    if (session && session->lease_ == slot.lease) {
+      session->deliver(std::move(reply));
+      metrics.replies_matched.add();
+    } else {
+      metrics.replies_unmatched.add();
+    }
+  }
+
+  // Times one packet in decode_sample_rate from here to the end of routing.
+  class decode_timer {
+  public:
+    explicit decode_timer(icmp_dispatcher &dispatcher) noexcept
+        : sampled_(dispatcher.packets_routed_++ %
+                       module_metrics::decode_sample_rate ==
+                   0) {
+      if (sampled_) {
+        started_ = clock::now();
+      }
+    }
+
+    ~decode_timer() {
+      if (sampled_) {
+        module_metrics::instance()
+            .stage(probe_stage::decode)
+            .record(clock::now() - started_);
+      }
+    }
+
+    decode_timer(const decode_timer &) = delete;
+    decode_timer &operator=(const decode_timer &) = delete;
+
+  private:
+    bool sampled_;
+    clock::time_point started_;
+  };
+
+  std::optional<asio::ip::icmp::socket> socket_;
+  std::vector<icmp_session<IPType> *> routes_;
+  std::size_t sessions_ = 0;
+  // This context's identifiers are [partition_first_, partition_first_ +
+  // partition_size_), and the next lease starts looking at next_offset_.
+  std::size_t partition_first_ = 0;
+  std::size_t partition_size_ = 0;
+  std::size_t next_offset_ = 0;
+  int current_ttl_ = -1;
+  hop_limit_mode hop_limit_mode_ = hop_limit_mode::socket_option;
+  bool receiving_ = false;
+  icmp_transport transport_ = icmp_transport::raw;
+  std::vector<probe_slot> slots_;
+  unsigned short next_slot_ = 0;
+  std::uint32_t leases_issued_ = 0;
+  std::vector<char> receive_buffer_;
+  std::uint64_t packets_routed_ = 0;
+  std::atomic<std::uint64_t> packets_sent_{0};
+  std::atomic<std::uint64_t> send_calls_{0};
+  std::atomic<std::uint64_t> packets_received_{0};
+  std::atomic<std::uint64_t> receive_calls_{0};
+};
+
+template <class IPType>
+icmp_session<IPType>::icmp_session(const asio::any_io_executor &executor,
+                                   std::size_t identifier_count)
+    : dispatcher_(icmp_dispatcher<IPType>::get(executor)),
+      count_(identifier_count), signal_(executor) {
+  base_ = dispatcher_.attach(*this, count_, executor);
+}
+
+template <class IPType> icmp_session<IPType>::~icmp_session() {
+  module_metrics::instance().icmp<IPType>().replies_queued.sub(
+      static_cast<std::int64_t>(queued_));
+  dispatcher_.detach(base_, count_);
+}
+
+template <class IPType>
+asio::awaitable<std::chrono::steady_clock::time_point>
+icmp_session<IPType>::send_to(asio::const_buffer buffer,
+                              const asio::ip::icmp::endpoint &destination,
+                              int ttl, std::error_code &ec) {
+  return dispatcher_.send_to(*this, buffer, destination, ttl, ec);
+}
+
+template <class IPType>
+asio::awaitable<std::chrono::steady_clock::time_point>
+icmp_session<IPType>::send_batch(std::span<const icmp_probe> probes, int ttl,
+                                 std::error_code &ec,
+                                 std::span<std::error_code> errors) {
+  return dispatcher_.send_batch(*this, probes, ttl, ec, errors);
+}
+} // namespace net
+
+#endif // ICMP_DISPATCHER_HPP
@@ -12,10 +12,17 @@
 #define ICMP_HEADER_HPP
 
 #include <algorithm>
+#include <cstddef>
+#include <cstring>
 #include <istream>
+#include <iterator>
+#include <memory>
 #include <ostream>
+#include <span>
 #include <type_traits>
 
+#include "checksum.hpp"
+
 // ICMP header for both IPv4 and IPv6.
 //
 // The wire format of an ICMP header is:
@@ -71,6 +78,12 @@ public:
 
   icmp_header() noexcept { std::fill(rep_, rep_ + sizeof(rep_), 0); }
 
+  // Copies the header from the start of `bytes`.
+  explicit icmp_header(std::span<const std::byte> bytes) noexcept
+      : icmp_header() {
+    std::memcpy(rep_, bytes.data(), std::min(bytes.size(), sizeof(rep_)));
+  }
+
   ~icmp_header() noexcept = default;
 
   icmp_header(const icmp_header &ih) noexcept {
@@ -81,6 +94,9 @@ public:
     std::copy(ih.rep_, ih.rep_ + sizeof(rep_), rep_);
   }
 
+  icmp_header &operator=(const icmp_header &) noexcept = default;
+  icmp_header &operator=(icmp_header &&) noexcept = default;
+
   unsigned char type() const noexcept { return rep_[0]; }
   unsigned char code() const noexcept { return rep_[1]; }
   unsigned short checksum() const noexcept { return decode(2, 3); }
@@ -93,6 +109,10 @@ public:
   void identifier(unsigned short n) noexcept { encode(4, 5, n); }
   void sequence_number(unsigned short n) noexcept { encode(6, 7, n); }
 
+  std::span<const std::byte, 8> bytes() const noexcept {
+    return std::as_bytes(std::span<const unsigned char, 8>(rep_));
+  }
+
   friend std::istream &operator>>(std::istream &is, icmp_header &header) {
     return is.read(reinterpret_cast<char *>(header.rep_), 8);
   }
@@ -117,6 +137,17 @@ private:
 template <typename Iterator>
 void compute_checksum(icmp_header &header, Iterator body_begin,
                       std::type_identity_t<Iterator> body_end) {
+  if constexpr (std::contiguous_iterator<Iterator>) {
+    // Word at a time, see checksum.hpp.
+    header.checksum(0);
+    auto body_size = static_cast<std::size_t>(body_end - body_begin);
+    auto sum = checksum_add(header.bytes());
+    sum = checksum_add(
+        std::as_bytes(std::span(std::to_address(body_begin), body_size)), sum);
+    header.checksum(checksum_finish(sum));
+    return;
+  }
+
   unsigned int sum = (header.type() << 8) + header.code() +
                      header.identifier() + header.sequence_number();
 
@@ -0,0 +1,516 @@
+#ifndef ICMP_TRANSPORT_HPP
+#define ICMP_TRANSPORT_HPP
+
+#include <asio.hpp>
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstring>
+#include <span>
+#include <system_error>
+#include <type_traits>
+#include <vector>
+
+#include "header_view.hpp"
+#include "icmp_header.hpp"
+#include "icmp_utils.hpp"
+
+#if defined(__linux__)
+#include <cerrno>
+#include <linux/errqueue.h>
+#include <linux/filter.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+namespace net {
+// How the dispatcher talks ICMP. Raw sockets need CAP_NET_RAW; datagram
+// ("ping") sockets only need the group to be in net.ipv4.ping_group_range.
+enum class icmp_transport { automatic, raw, datagram };
+
+// Read when a dispatcher opens its socket, so changing it only affects
+// sockets opened afterwards.
+inline std::atomic<icmp_transport> &icmp_transport_preference() noexcept {
+  static std::atomic<icmp_transport> preference{icmp_transport::automatic};
+  return preference;
+}
+
+// Whether sockets opened from now on report kernel receive timestamps.
+inline std::atomic_bool &icmp_kernel_timestamps() noexcept {
+  static std::atomic_bool enabled{true};
+  return enabled;
+}
+
+// Whether probes are sent and read in batches (sendmmsg/recvmmsg) instead
+// of one system call per packet.
+inline std::atomic_bool &icmp_batched_io() noexcept {
+  static std::atomic_bool enabled{true};
+  return enabled;
+}
+
+// Whether raw sockets opened from now on get an icmp_filter attached.
+inline std::atomic_bool &icmp_filter_enabled() noexcept {
+  static std::atomic_bool enabled{true};
+  return enabled;
+}
+
+#if defined(__linux__)
+namespace detail {
+template <class IPType> constexpr int icmp_family() noexcept {
+  return std::is_same_v<IPType, use_ipv4_t> ? AF_INET : AF_INET6;
+}
+
+template <class IPType> constexpr int icmp_level() noexcept {
+  return std::is_same_v<IPType, use_ipv4_t> ? SOL_IP : SOL_IPV6;
+}
+
+// Control message types carrying the TTL and a queued error.
+template <class IPType> constexpr int ttl_message() noexcept {
+  if constexpr (std::is_same_v<IPType, use_ipv4_t>) {
+    return IP_TTL;
+  } else {
+    return IPV6_HOPLIMIT;
+  }
+}
+
+template <class IPType> constexpr int error_message() noexcept {
+  if constexpr (std::is_same_v<IPType, use_ipv4_t>) {
+    return IP_RECVERR;
+  } else {
+    return IPV6_RECVERR;
+  }
+}
+
+inline void set_int_option(int fd, int level, int name, std::error_code &ec) {
+  int value = 1;
+  if (::setsockopt(fd, level, name, &value, sizeof(value)) != 0) {
+    ec.assign(errno, asio::error::get_system_category());
+  }
+}
+
+// Room for one int-valued control message: the hop limit of one send.
+struct alignas(cmsghdr) hop_limit_control {
+  unsigned char data[CMSG_SPACE(sizeof(int))];
+};
+
+// Attaches `hops` to `message` as an IP_TTL or IPV6_HOPLIMIT control
+// message, overriding the socket's hop limit for this packet only.
+template <class IPType>
+void set_hop_limit(msghdr &message, hop_limit_control &control, int hops) {
+  message.msg_control = control.data;
+  message.msg_controllen = sizeof(control.data);
+  auto *cmsg = CMSG_FIRSTHDR(&message);
+  cmsg->cmsg_level = icmp_level<IPType>();
+  cmsg->cmsg_type = ttl_message<IPType>();
+  cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+  std::memcpy(CMSG_DATA(cmsg), &hops, sizeof(hops));
+}
+
+// Whether the kernel takes the hop limit of a packet sent on `socket` as a
+// control message; older kernels reject IP_TTL there with EINVAL. With
+// MSG_PROBE the kernel parses and routes a message to the loopback address
+// without sending it. Any failure counts as a no, since setting the socket
+// option always works.
+template <class IPType>
+bool accepts_hop_limit_control(asio::ip::icmp::socket &socket) {
+  std::array<unsigned char, 8> request{select_icmp_type<IPType>(
+      icmp_header::ipv4::echo_request, icmp_header::ipv6::echo_request)};
+  asio::ip::icmp::endpoint loopback;
+  if constexpr (std::is_same_v<IPType, use_ipv4_t>) {
+    loopback.address(asio::ip::address_v4::loopback());
+  } else {
+    loopback.address(asio::ip::address_v6::loopback());
+  }
+  iovec iov{request.data(), request.size()};
+  msghdr message{};
+  message.msg_name = loopback.data();
+  message.msg_namelen = static_cast<socklen_t>(loopback.size());
+  message.msg_iov = &iov;
+  message.msg_iovlen = 1;
+  hop_limit_control control;
+  set_hop_limit<IPType>(message, control, 64);
+  // MSG_PROBE to the kernel, which glibc only knows by its old name.
+  constexpr int msg_probe = 0x10;
+  return ::sendmsg(socket.native_handle(), &message,
+                   msg_probe | MSG_DONTWAIT) >= 0;
+}
+
+// The sender of a datagram, or the router named in an error report.
+template <class IPType>
+ip_token_to_header_t<IPType> make_header(const sockaddr_storage &storage) {
+  ip_token_to_header_t<IPType> header;
+  if constexpr (std::is_same_v<IPType, use_ipv4_t>) {
+    asio::ip::address_v4::bytes_type bytes;
+    std::memcpy(bytes.data(),
+                &reinterpret_cast<const sockaddr_in &>(storage).sin_addr,
+                bytes.size());
+    header.set_source_address(asio::ip::address_v4(bytes));
+  } else {
+    asio::ip::address_v6::bytes_type bytes;
+    std::memcpy(bytes.data(),
+                &reinterpret_cast<const sockaddr_in6 &>(storage).sin6_addr,
+                bytes.size());
+    header.set_source_address(asio::ip::address_v6(bytes));
+  }
+  return header;
+}
+
+inline asio::ip::icmp::endpoint to_endpoint(const sockaddr_storage &storage) {
+  asio::ip::icmp::endpoint endpoint;
+  std::memcpy(endpoint.data(), &storage, endpoint.capacity());
+  endpoint.resize(storage.ss_family == AF_INET ? sizeof(sockaddr_in)
+                                               : sizeof(sockaddr_in6));
+  return endpoint;
+}
+} // namespace detail
+
+// Socket option attaching a classic BPF program to a raw ICMP socket. It
+// keeps echo replies whose identifier is in [first, last], and time exceeded
+// and destination unreachable errors quoting such an identifier; the kernel
+// drops everything else before it is queued or wakes us up.
+//
+// IPv4 raw sockets see the IP header, IPv6 ones start at the ICMPv6 header.
+// Errors quote the original IP header followed by our echo request.
+class icmp_filter {
+public:
+  template <class IPType>
+  icmp_filter(IPType, unsigned short first, unsigned short last) {
+    constexpr unsigned int accept = 0xFFFFFFFF;
+    constexpr unsigned int drop = 0;
+    if constexpr (std::is_same_v<IPType, use_ipv4_t>) {
+      code_ = {
+          // X = IP header length, A = ICMP type
+          BPF_STMT(BPF_LDX | BPF_B | BPF_MSH, 0),
+          BPF_STMT(BPF_LD | BPF_B | BPF_IND, 0),
+          BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 0, 2, 0),
+          BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 11, 3, 0),
+          BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 3, 2, 12),
+          // echo reply: A = identifier
+          BPF_STMT(BPF_LD | BPF_H | BPF_IND, 4),
+          BPF_JUMP(BPF_JMP | BPF_JA, 7, 0, 0),
+          // error: X = start of the quoted ICMP header, A = identifier
+          BPF_STMT(BPF_LD | BPF_B | BPF_IND, 8),
+          BPF_STMT(BPF_ALU | BPF_AND | BPF_K, 0xF),
+          BPF_STMT(BPF_ALU | BPF_LSH | BPF_K, 2),
+          BPF_STMT(BPF_ALU | BPF_ADD | BPF_X, 0),
+          BPF_STMT(BPF_ALU | BPF_ADD | BPF_K, 8),
+          BPF_STMT(BPF_MISC | BPF_TAX, 0),
+          BPF_STMT(BPF_LD | BPF_H | BPF_IND, 4),
+          // first <= A <= last
+          BPF_JUMP(BPF_JMP | BPF_JGE | BPF_K, first, 0, 2),
+          BPF_JUMP(BPF_JMP | BPF_JGT | BPF_K, last, 1, 0),
+          BPF_STMT(BPF_RET | BPF_K, accept),
+          BPF_STMT(BPF_RET | BPF_K, drop),
+      };
+    } else {
+      code_ = {
+          BPF_STMT(BPF_LD | BPF_B | BPF_ABS, 0),
+          BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 129, 2, 0),
+          BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 3, 3, 0),
+          BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 1, 2, 6),
+          // echo reply
+          BPF_STMT(BPF_LD | BPF_H | BPF_ABS, 4),
+          BPF_JUMP(BPF_JMP | BPF_JA, 1, 0, 0),
+          // error: ICMPv6 header, IPv6 header, then our echo request
+          BPF_STMT(BPF_LD | BPF_H | BPF_ABS, 8 + 40 + 4),
+          BPF_JUMP(BPF_JMP | BPF_JGE | BPF_K, first, 0, 2),
+          BPF_JUMP(BPF_JMP | BPF_JGT | BPF_K, last, 1, 0),
+          BPF_STMT(BPF_RET | BPF_K, accept),
+          BPF_STMT(BPF_RET | BPF_K, drop),
+      };
+    }
+    program_.len = static_cast<unsigned short>(code_.size());
+    program_.filter = code_.data();
+  }
+
+  icmp_filter(const icmp_filter &) = delete;
+  icmp_filter &operator=(const icmp_filter &) = delete;
+
+  template <class Protocol> int level(const Protocol &) const noexcept {
+    return SOL_SOCKET;
+  }
+  template <class Protocol> int name(const Protocol &) const noexcept {
+    return SO_ATTACH_FILTER;
+  }
+  template <class Protocol> const void *data(const Protocol &) const noexcept {
+    return &program_;
+  }
+  template <class Protocol> std::size_t size(const Protocol &) const noexcept {
+    return sizeof(program_);
+  }
+
+private:
+  std::vector<sock_filter> code_;
+  sock_fprog program_{};
+};
+
+// Opens a SOCK_DGRAM ICMP socket and hands it to `socket`. Fails with
+// EACCES (or EPERM) when ping_group_range excludes the calling process.
+// Errors such as time exceeded are not readable as data on these sockets,
+// so IP_RECVERR is enabled and they are collected from the error queue.
+template <class IPType>
+void open_datagram_socket(asio::ip::icmp::socket &socket,
+                          std::error_code &ec) {
+  constexpr bool is_v4 = std::is_same_v<IPType, use_ipv4_t>;
+  int fd = ::socket(detail::icmp_family<IPType>(),
+                    SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC,
+                    is_v4 ? static_cast<int>(IPPROTO_ICMP)
+                          : static_cast<int>(IPPROTO_ICMPV6));
+  if (fd < 0) {
+    ec.assign(errno, asio::error::get_system_category());
+    return;
+  }
+  if constexpr (is_v4) {
+    detail::set_int_option(fd, SOL_IP, IP_RECVERR, ec);
+    if (!ec) {
+      detail::set_int_option(fd, SOL_IP, IP_RECVTTL, ec);
+    }
+  } else {
+    detail::set_int_option(fd, SOL_IPV6, IPV6_RECVERR, ec);
+    if (!ec) {
+      detail::set_int_option(fd, SOL_IPV6, IPV6_RECVHOPLIMIT, ec);
+    }
+  }
+  if (!ec) {
+    socket.assign(icmp_protocol<IPType>(), fd, ec);
+  }
+  if (ec) {
+    ::close(fd);
+  }
+}
+
+// One message read with recvmsg and what its control messages carried.
+struct received_message {
+  std::size_t length = 0;
+  sockaddr_storage from{};
+  std::chrono::steady_clock::time_point received_at{};
+  int ttl = 0;
+  bool is_error = false;
+  unsigned char error_type = 0;
+  unsigned char error_code = 0;
+};
+
+namespace detail {
+// Kernel timestamps are CLOCK_REALTIME. Move them onto the steady clock by
+// how long ago they were taken, so they compare with steady send times.
+inline std::chrono::steady_clock::time_point
+to_steady_time(const timespec &stamp) {
+  auto now = std::chrono::system_clock::now();
+  auto steady_now = std::chrono::steady_clock::now();
+  auto taken = std::chrono::system_clock::time_point(
+      std::chrono::duration_cast<std::chrono::system_clock::duration>(
+          std::chrono::seconds(stamp.tv_sec) +
+          std::chrono::nanoseconds(stamp.tv_nsec)));
+  return steady_now - std::max(now - taken,
+                               std::chrono::system_clock::duration::zero());
+}
+} // namespace detail
+
+// Asks the kernel to stamp every received packet (SO_TIMESTAMPNS), so RTTs
+// do not include the time spent waiting for the reactor and the coroutine.
+inline void enable_kernel_timestamps(asio::ip::icmp::socket &socket,
+                                     std::error_code &ec) {
+  detail::set_int_option(socket.native_handle(), SOL_SOCKET, SO_TIMESTAMPNS,
+                         ec);
+}
+
+namespace detail {
+// Fills `received` from a message recvmsg/recvmmsg returned.
+template <class IPType>
+void parse_message(const msghdr &message, std::size_t length,
+                   received_message &received) {
+  constexpr bool is_v4 = std::is_same_v<IPType, use_ipv4_t>;
+  received.length = length;
+  received.received_at = std::chrono::steady_clock::now();
+
+  for (auto *cmsg = CMSG_FIRSTHDR(&message); cmsg;
+       cmsg = CMSG_NXTHDR(const_cast<msghdr *>(&message), cmsg)) {
+    if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_TIMESTAMPNS) {
+      timespec stamp;
+      std::memcpy(&stamp, CMSG_DATA(cmsg), sizeof(stamp));
+      received.received_at = to_steady_time(stamp);
+    }
+    if (cmsg->cmsg_level != icmp_level<IPType>()) {
+      continue;
+    }
+    if (cmsg->cmsg_type == ttl_message<IPType>()) {
+      std::memcpy(&received.ttl, CMSG_DATA(cmsg), sizeof(received.ttl));
+    } else if (cmsg->cmsg_type == error_message<IPType>()) {
+      sock_extended_err error;
+      std::memcpy(&error, CMSG_DATA(cmsg), sizeof(error));
+      if (error.ee_origin != (is_v4 ? SO_EE_ORIGIN_ICMP : SO_EE_ORIGIN_ICMP6)) {
+        continue;
+      }
+      // The offender address follows the error in the same message.
+      std::memcpy(&received.from, CMSG_DATA(cmsg) + sizeof(sock_extended_err),
+                  is_v4 ? sizeof(sockaddr_in) : sizeof(sockaddr_in6));
+      received.error_type = error.ee_type;
+      received.error_code = error.ee_code;
+      received.is_error = true;
+    }
+  }
+}
+} // namespace detail
+
+// Most messages one recvmmsg call reads.
+inline constexpr std::size_t max_receive_batch = 32;
+
+// Reads every message queued with `flags` and passes each one, with its
+// bytes, to the handler until reading would block. The descriptor is edge
+// triggered, so stopping early would strand packets until the next arrives.
+//
+// `buffer` is split into `batch` slices and up to that many messages are
+// read per recvmmsg call; a batch of 1 reads them one call at a time.
+// Returns the number of calls made.
+template <class IPType, class Handler>
+std::size_t drain_socket(asio::ip::icmp::socket &socket,
+                         std::span<char> buffer, std::size_t batch, int flags,
+                         Handler &&handler) {
+  struct alignas(cmsghdr) control_block {
+    char data[512];
+  };
+
+  const int fd = socket.native_handle();
+  batch = std::clamp<std::size_t>(batch, 1, max_receive_batch);
+  const std::size_t slice = buffer.size() / batch;
+  std::array<mmsghdr, max_receive_batch> messages;
+  std::array<iovec, max_receive_batch> iovs;
+  std::array<received_message, max_receive_batch> received;
+  std::array<control_block, max_receive_batch> controls;
+
+  // A pending socket error is reported once by a plain read, after which
+  // reads succeed again; anything persistent ends the drain.
+  std::size_t calls = 0;
+  int errors = 0;
+  while (errors < 8) {
+    for (std::size_t i = 0; i < batch; ++i) {
+      received[i] = {};
+      iovs[i] = {buffer.data() + i * slice, slice};
+      messages[i] = {};
+      auto &header = messages[i].msg_hdr;
+      header.msg_name = &received[i].from;
+      header.msg_namelen = sizeof(received[i].from);
+      header.msg_iov = &iovs[i];
+      header.msg_iovlen = 1;
+      header.msg_control = controls[i].data;
+      header.msg_controllen = sizeof(controls[i].data);
+    }
+
+    int count = ::recvmmsg(fd, messages.data(), static_cast<unsigned>(batch),
+                           flags | MSG_DONTWAIT, nullptr);
+    ++calls;
+    if (count < 0) {
+      if (errno == EAGAIN || errno == EWOULDBLOCK) {
+        break;
+      }
+      ++errors;
+      continue;
+    }
+    for (int i = 0; i < count; ++i) {
+      detail::parse_message<IPType>(messages[i].msg_hdr, messages[i].msg_len,
+                                    received[i]);
+      handler(received[i], std::span<const char>(buffer.data() + i * slice,
+                                                 received[i].length));
+    }
+  }
+  return calls;
+}
+
+// How far send_messages got through its messages.
+struct send_progress {
+  // Messages the kernel accepted or refused; the rest are still to send.
+  std::size_t consumed = 0;
+  std::size_t accepted = 0;
+  // Calls that accepted any message.
+  std::size_t calls = 0;
+  // Whether it stopped at a full send buffer.
+  bool would_block = false;
+};
+
+// Sends messages with as few sendmmsg calls as the kernel allows, until all
+// are consumed or the send buffer is full. It never waits: once the kernel
+// would block, the caller waits for the socket to become writable and sends
+// the rest. A message the kernel refuses is skipped and handed to
+// on_refused(index, error), like a failed send_to.
+template <class OnRefused>
+send_progress send_messages(asio::ip::icmp::socket &socket,
+                            std::span<mmsghdr> messages,
+                            OnRefused &&on_refused) {
+  const int fd = socket.native_handle();
+  send_progress progress;
+  while (progress.consumed < messages.size()) {
+    int count = ::sendmmsg(
+        fd, messages.data() + progress.consumed,
+        static_cast<unsigned>(messages.size() - progress.consumed),
+        MSG_DONTWAIT);
+    if (count >= 0) {
+      ++progress.calls;
+      progress.consumed += static_cast<std::size_t>(count);
+      progress.accepted += static_cast<std::size_t>(count);
+      continue;
+    }
+    const int error = errno;
+    if (error == EAGAIN || error == EWOULDBLOCK) {
+      progress.would_block = true;
+      break;
+    }
+    on_refused(progress.consumed,
+               std::error_code(error, asio::error::get_system_category()));
+    ++progress.consumed;
+  }
+  return progress;
+}
+
+// Reads everything queued on a datagram socket, data first and then the
+// error queue.
+//
+// The kernel strips the IP header, so each reply gets a synthesized one
+// carrying the sender (or, for errors, the offending router) and the TTL
+// from ancillary data. For errors the ICMP header is the echo request the
+// error quotes, retyped with the error's type and code; this is what
+// decode_reply yields for the same error on a raw socket.
+template <class IPType, class Handler>
+std::size_t drain_datagram_socket(asio::ip::icmp::socket &socket,
+                                  std::span<char> buffer, std::size_t batch,
+                                  Handler &&handler) {
+  auto on_message = [&](const received_message &received,
+                        std::span<const char> data) {
+    icmp_header_view view(std::as_bytes(data));
+    if (!view.valid()) {
+      return;
+    }
+    icmp_reply<IPType> reply;
+    reply.icmp_hdr = icmp_header(view.bytes());
+    if (received.is_error) {
+      reply.icmp_hdr.type(received.error_type);
+      reply.icmp_hdr.code(received.error_code);
+    }
+    reply.ip_hdr = detail::make_header<IPType>(received.from);
+    reply.ip_hdr.set_time_to_live(static_cast<unsigned char>(received.ttl));
+    reply.length = received.length;
+    if constexpr (std::is_same_v<IPType, use_ipv4_t>) {
+      // Callers subtract the IP header to get the ICMP size.
+      reply.length += reply.ip_hdr.header_length();
+    }
+    reply.received_at = received.received_at;
+    handler(std::move(reply));
+  };
+
+  std::size_t calls =
+      drain_socket<IPType>(socket, buffer, batch, 0, on_message);
+  calls += drain_socket<IPType>(
+      socket, buffer, batch, MSG_ERRQUEUE,
+      [&](const received_message &received, std::span<const char> data) {
+        if (received.is_error) {
+          on_message(received, data);
+        }
+      });
+  return calls;
+}
+#endif
+} // namespace net
+
+#endif // ICMP_TRANSPORT_HPP
@@ -0,0 +1,216 @@
+#ifndef ICMP_UTILS_HPP
+#define ICMP_UTILS_HPP
+
+#include <asio.hpp>
+#include <chrono>
+#include <cstddef>
+#include <cstring>
+#include <span>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "checksum.hpp"
+#include "header_view.hpp"
+#include "icmp_header.hpp"
+#include "ipv4_header.hpp"
+#include "ipv6_header.hpp"
+
+namespace net {
+struct use_ipv4_t {};
+struct use_ipv6_t {};
+
+inline constexpr use_ipv4_t use_ipv4;
+inline constexpr use_ipv6_t use_ipv6;
+
+template <class IPType> struct ip_token_to_header {};
+
+template <> struct ip_token_to_header<use_ipv4_t> {
+  using type = ipv4_header;
+};
+
+template <> struct ip_token_to_header<use_ipv6_t> {
+  using type = ipv6_header;
+};
+
+template <class IPType>
+using ip_token_to_header_t =
+    typename ip_token_to_header<std::remove_cvref_t<IPType>>::type;
+
+template <class IPType>
+inline constexpr bool is_ip_token_v =
+    std::is_same_v<IPType, use_ipv4_t> || std::is_same_v<IPType, use_ipv6_t>;
+
+template <class HeaderType, class OHT = std::remove_cvref_t<HeaderType>>
+  requires std::is_same_v<OHT, ipv4_header> || std::is_same_v<OHT, ipv6_header>
+struct icmp_compose {
+  OHT ipv4header{};
+  icmp_header icmpheader{};
+  std::size_t length = 0;
+  std::chrono::steady_clock::duration elapsed{};
+};
+
+// A decoded reply as handed to the session that owns its identifier.
+template <class IPType> struct icmp_reply {
+  ip_token_to_header_t<IPType> ip_hdr{};
+  icmp_header icmp_hdr{};
+  std::size_t length = 0;
+  std::chrono::steady_clock::time_point received_at{};
+};
+
+template <class IPType> constexpr asio::ip::icmp icmp_protocol() noexcept {
+  if constexpr (std::is_same_v<IPType, use_ipv4_t>) {
+    return asio::ip::icmp::v4();
+  } else {
+    return asio::ip::icmp::v6();
+  }
+}
+
+template <class IPType>
+constexpr unsigned char select_icmp_type(icmp_header::ipv4 v4,
+                                         icmp_header::ipv6 v6) noexcept {
+  if constexpr (std::is_same_v<IPType, use_ipv4_t>) {
+    return std::to_underlying(v4);
+  } else {
+    return std::to_underlying(v6);
+  }
+}
+
+inline unsigned short process_identifier() noexcept {
+#if defined(ASIO_WINDOWS)
+  return static_cast<unsigned short>(::GetCurrentProcessId());
+#else
+  return static_cast<unsigned short>(::getpid());
+#endif
+}
+
+template <class IPType>
+using ip_token_to_header_view_t =
+    std::conditional_t<std::is_same_v<std::remove_cvref_t<IPType>, use_ipv4_t>,
+                       ipv4_header_view, ipv6_header_view>;
+
+enum class decode_result {
+  reply,
+  // Truncated or otherwise not a well-formed packet.
+  malformed,
+  bad_checksum,
+  // Well formed, but not a message that answers a probe.
+  other_type,
+};
+
+// Decodes an echo reply, time exceeded or destination unreachable message
+// in place. The error messages quote the probe they answer, so its
+// identifier and sequence number are copied into the otherwise unused
+// fields of the returned ICMP header.
+template <class IPType>
+inline decode_result decode_reply(std::span<const std::byte> packet,
+                         const asio::ip::icmp::endpoint &sender,
+                         ip_token_to_header_t<IPType> &ip_hdr,
+                         icmp_header &icmp_hdr) {
+  std::span<const std::byte> icmp_bytes = packet;
+  if constexpr (std::is_same_v<IPType, use_ipv4_t>) {
+    ipv4_header_view ip_view(packet);
+    if (!ip_view.valid()) {
+      return decode_result::malformed;
+    }
+    ip_hdr = ipv4_header(ip_view.bytes());
+    icmp_bytes = ip_view.payload();
+  } else {
+    ip_hdr.set_source_address(sender.address().to_v6());
+  }
+  icmp_header_view icmp_view(icmp_bytes);
+  if (!icmp_view.valid()) {
+    return decode_result::malformed;
+  }
+  if constexpr (std::is_same_v<IPType, use_ipv4_t>) {
+    // The kernel already verifies ICMPv6 checksums, which cover a pseudo
+    // header we do not have here.
+    if (internet_checksum(icmp_bytes) != 0) {
+      return decode_result::bad_checksum;
+    }
+  }
+  icmp_hdr = icmp_header(icmp_view.bytes());
+
+  if (icmp_hdr.type() ==
+          select_icmp_type<IPType>(icmp_header::ipv4::time_exceeded,
+                                   icmp_header::ipv6::time_exceeded) ||
+      icmp_hdr.type() == select_icmp_type<IPType>(
+                             icmp_header::ipv4::destination_unreachable,
+                             icmp_header::ipv6::destination_unreachable)) {
+    ip_token_to_header_view_t<IPType> quoted_ip_view(icmp_view.payload());
+    if (!quoted_ip_view.valid()) {
+      return decode_result::malformed;
+    }
+    icmp_header_view quoted_icmp_view(quoted_ip_view.payload());
+    if (!quoted_icmp_view.valid()) {
+      return decode_result::malformed;
+    }
+    icmp_hdr.identifier(quoted_icmp_view.identifier());
+    icmp_hdr.sequence_number(quoted_icmp_view.sequence_number());
+    return decode_result::reply;
+  }
+  return icmp_hdr.type() ==
+                 select_icmp_type<IPType>(icmp_header::ipv4::echo_reply,
+                                          icmp_header::ipv6::echo_reply)
+             ? decode_result::reply
+             : decode_result::other_type;
+}
+
+// Serializes an echo request with the given identifier and sequence number
+// into `out` and returns the bytes written, or an empty buffer if it does
+// not fit.
+template <class IPType>
+inline asio::const_buffer encode_echo_request(std::span<std::byte> out,
+                                              unsigned short identifier,
+                                              unsigned short sequence_number,
+                                              std::string_view body) {
+  icmp_header echo_request;
+  echo_request.type(select_icmp_type<IPType>(icmp_header::ipv4::echo_request,
+                                             icmp_header::ipv6::echo_request));
+  echo_request.code(0);
+  echo_request.identifier(identifier);
+  echo_request.sequence_number(sequence_number);
+  compute_checksum(echo_request, body.begin(), body.end());
+
+  auto header = echo_request.bytes();
+  if (out.size() < header.size() + body.size()) {
+    return {};
+  }
+  std::memcpy(out.data(), header.data(), header.size());
+  std::memcpy(out.data() + header.size(), body.data(), body.size());
+  return asio::buffer(out.data(), header.size() + body.size());
+}
+
+// An echo request built once per identifier. next() only rewrites the
+// sequence number and patches the checksum (RFC 1624), so a probe costs the
+// same whatever the payload size. Sends are synchronous, so the returned
+// buffer may be reused as soon as the probe is sent.
+template <class IPType> class echo_request_template {
+public:
+  echo_request_template(unsigned short identifier, std::string_view body)
+      : bytes_(icmp_header_view::header_size + body.size()) {
+    encode_echo_request<IPType>(bytes_, identifier, 0, body);
+  }
+
+  asio::const_buffer next(unsigned short sequence_number) noexcept {
+    icmp_header_view view(bytes_);
+    write_word(2, checksum_update(view.checksum(), view.sequence_number(),
+                                  sequence_number));
+    write_word(6, sequence_number);
+    return asio::buffer(bytes_.data(), bytes_.size());
+  }
+
+private:
+  void write_word(std::size_t offset, unsigned short value) noexcept {
+    bytes_[offset] = static_cast<std::byte>(value >> 8);
+    bytes_[offset + 1] = static_cast<std::byte>(value & 0xFF);
+  }
+
+  std::vector<std::byte> bytes_;
+};
+
+inline constexpr std::string_view echo_body = "\"Hello!\" from Asio ping.";
+} // namespace net
+
+#endif // ICMP_UTILS_HPP
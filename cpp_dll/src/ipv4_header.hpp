@@ -13,7 +13,10 @@
 
 #include <algorithm>
 #include <asio/ip/address_v4.hpp>
+#include <cstddef>
+#include <cstring>
 #include <iostream>
+#include <span>
 
 // Packet header for IPv4.
 //
@@ -53,6 +56,12 @@ namespace net {
 class ipv4_header {
 public:
   ipv4_header() noexcept { std::fill(rep_, rep_ + sizeof(rep_), 0); }
+
+  // Copies the header, options included, from the start of `bytes`.
+  explicit ipv4_header(std::span<const std::byte> bytes) noexcept
+      : ipv4_header() {
+    std::memcpy(rep_, bytes.data(), std::min(bytes.size(), sizeof(rep_)));
+  }
   ~ipv4_header() noexcept = default;
 
   ipv4_header(const ipv4_header &ih) noexcept {
@@ -63,6 +72,9 @@ public:
     std::copy(ih.rep_, ih.rep_ + sizeof(rep_), rep_);
   }
 
+  ipv4_header &operator=(const ipv4_header &) noexcept = default;
+  ipv4_header &operator=(ipv4_header &&) noexcept = default;
+
   unsigned char version() const noexcept { return (rep_[0] >> 4) & 0xF; }
   unsigned short header_length() const noexcept { return (rep_[0] & 0xF) * 4; }
   unsigned char type_of_service() const noexcept { return rep_[1]; }
@@ -89,6 +101,18 @@ public:
     return asio::ip::address_v4(bytes);
   }
 
+  // Used when the kernel strips the IP header (e.g. ICMP datagram sockets)
+  // and the fields are known from the sender and ancillary data instead.
+  void set_source_address(const asio::ip::address_v4 &addr) noexcept {
+    auto bytes = addr.to_bytes();
+    for (std::size_t i = 0; i < bytes.size(); ++i)
+      rep_[12 + i] = bytes[i];
+    // version 4, 20 byte header
+    rep_[0] = 0x45;
+  }
+
+  void set_time_to_live(unsigned char ttl) noexcept { rep_[8] = ttl; }
+
   friend std::istream &operator>>(std::istream &is, ipv4_header &header) {
     is.read(reinterpret_cast<char *>(header.rep_), 20);
     if (header.version() != 4)
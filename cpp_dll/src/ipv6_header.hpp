@@ -3,7 +3,10 @@
 
 #include <algorithm>
 #include <asio/ip/address_v6.hpp>
+#include <cstddef>
+#include <cstring>
 #include <iostream>
+#include <span>
 
 // Packet header for IPv6.
 //
@@ -40,6 +43,12 @@ namespace net {
 class ipv6_header {
 public:
   ipv6_header() { std::fill(rep_, rep_ + sizeof(rep_), 0); }
+
+  // Copies the header from the start of `bytes`.
+  explicit ipv6_header(std::span<const std::byte> bytes) noexcept
+      : ipv6_header() {
+    std::memcpy(rep_, bytes.data(), std::min(bytes.size(), sizeof(rep_)));
+  }
   ~ipv6_header() noexcept = default;
 
   ipv6_header(const ipv6_header &ih) noexcept {
@@ -50,6 +59,9 @@ public:
     std::copy(ih.rep_, ih.rep_ + sizeof(rep_), rep_);
   }
 
+  ipv6_header &operator=(const ipv6_header &) noexcept = default;
+  ipv6_header &operator=(ipv6_header &&) noexcept = default;
+
   unsigned char version() const noexcept { return (rep_[0] >> 4) & 0xF; }
   unsigned char traffic_class() const noexcept {
     return ((rep_[0] & 0xF) << 4) | (rep_[1] >> 4) & 0xF;
@@ -87,6 +99,10 @@ public:
     rep_[0] = static_cast<unsigned char>((6 << 4) | (rep_[0] & 0x0F));
   }
 
+  void set_time_to_live(unsigned char hop_limit) noexcept {
+    rep_[7] = hop_limit;
+  }
+
   friend std::istream &operator>>(std::istream &is, ipv6_header &header) {
     is.read(reinterpret_cast<char *>(header.rep_), 40);
     if (header.version() != 6)
@@ -0,0 +1,49 @@
+#ifndef JOIN_HPP
+#define JOIN_HPP
+
+#include <asio.hpp>
+#include <asio/experimental/parallel_group.hpp>
+#include <exception>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+namespace net {
+// Runs `tasks` side by side and completes once every one of them has, so
+// whatever they borrow from the caller's frame outlives them. Cancelling
+// the caller cancels each task. The first exception a task threw is
+// rethrown, and a cancelled caller gets operation_aborted even when its
+// tasks swallowed theirs.
+inline asio::awaitable<void>
+join_all(std::vector<asio::awaitable<void>> tasks) {
+  if (tasks.empty()) {
+    co_return;
+  }
+  auto executor = co_await asio::this_coro::executor;
+  using operation = decltype(asio::co_spawn(
+      executor, std::declval<asio::awaitable<void>>(), asio::deferred));
+  std::vector<operation> operations;
+  operations.reserve(tasks.size());
+  for (auto &task : tasks) {
+    operations.push_back(
+        asio::co_spawn(executor, std::move(task), asio::deferred));
+  }
+
+  auto [order, exceptions] =
+      co_await asio::experimental::make_parallel_group(std::move(operations))
+          .async_wait(asio::experimental::wait_for_all(),
+                      asio::use_awaitable);
+  for (const auto &exception : exceptions) {
+    if (exception) {
+      std::rethrow_exception(exception);
+    }
+  }
+  auto state = co_await asio::this_coro::cancellation_state;
+  if (state.cancelled() != asio::cancellation_type::none) {
+    throw std::system_error(
+        std::error_code(asio::error::operation_aborted));
+  }
+}
+} // namespace net
+
+#endif // JOIN_HPP
@@ -2,14 +2,33 @@
 #include <chrono>
 #include <format>
 #include <iostream>
+#include <memory>
+#include <optional>
 #include <pybind11/pybind11.h>
+#include <pybind11/stl.h>
 #include <ranges>
 #include <sstream>
+#include <stdexcept>
 
+#include "asyncio_bridge.hpp"
+#include "dns_cache.hpp"
+#include "deadline.hpp"
+#include "dns_client.hpp"
+#include "engine.hpp"
+#include "icmp_dispatcher.hpp"
 #include "icmp_header.hpp"
+#include "icmp_transport.hpp"
 #include "ipv4_header.hpp"
+#include "metrics.hpp"
 #include "ping.hpp"
+#include "ping_many.hpp"
+#include "ping_table.hpp"
+#include "rtt_stats.hpp"
+#include "port_scan.hpp"
+#include "probe_cache.hpp"
+#include "sweep.hpp"
 #include "tcping.hpp"
+#include "tracert.hpp"
 
 namespace py = pybind11;
 
@@ -21,30 +40,38 @@ static inline py::dict make_status_dict(std::string_view status,
   return dict;
 }
 
-template <class IPType, class OriginalIPType = std::remove_cvref_t<IPType>>
-py::list ping(const std::string &dest, int count, int ttl, int timeout) {
-  asio::io_context io_context;
-  auto future = asio::co_spawn(
-      io_context,
-      net::async_ping(dest, count, ttl, std::chrono::milliseconds(timeout),
-                      OriginalIPType{}),
-      asio::use_future);
-  io_context.run();
+// Runs the awaitable on the shared engine and waits for it without holding
+// the GIL, so other Python threads keep running while the probe is in flight.
+template <class T> static T run_on_engine(asio::awaitable<T> awaitable) {
+  auto future = net::engine::instance().spawn(std::move(awaitable));
+  py::gil_scoped_release release;
+  return future.get();
+}
+
+// Bounds a whole call to `deadline` milliseconds; zero means no bound.
+template <class T>
+static asio::awaitable<T> within(asio::awaitable<T> awaitable, int deadline) {
+  return net::with_deadline(std::move(awaitable),
+                            std::chrono::milliseconds(deadline));
+}
+
+// Turns a thrown probe error into the single-entry list the ping APIs use.
+static py::list make_error_list(std::exception_ptr error) {
   py::list list;
-  if (future.wait_for(std::chrono::nanoseconds(0)) ==
-      std::future_status::deferred) {
-    list.append(make_status_dict("error",
-                                 "error occurred, the task was not processed"));
-    return list;
-  }
-  std::vector<net::icmp_compose<net::ip_token_to_header_t<OriginalIPType>>>
-      composes;
   try {
-    composes = future.get();
+    std::rethrow_exception(error);
   } catch (const std::exception &e) {
     list.append(make_status_dict("error", e.what()));
-    return list;
+  } catch (...) {
+    list.append(make_status_dict("error", "Unknown error occurred"));
   }
+  return list;
+}
+
+template <class HeaderType>
+py::list
+make_ping_list(const std::vector<net::icmp_compose<HeaderType>> &composes) {
+  py::list list;
   for (const auto &[ipv4_hdr, icmp_hdr, length, elapsed] : composes) {
     if (!length) {
       list.append(make_status_dict("error", "timeout"));
@@ -58,150 +85,1130 @@ py::list ping(const std::string &dest, int count, int ttl, int timeout) {
     dict["ttl"] = ipv4_hdr.time_to_live();
     dict["time"] =
         std::chrono::duration_cast<std::chrono::milliseconds>(elapsed).count();
+    dict["time_us"] =
+        std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count();
     list.append(std::move(dict));
   }
   return list;
 }
 
+// A read-only view of one column of a ping table, for memoryview() and
+// numpy.frombuffer(). It borrows the table's storage, so Python keeps the
+// table alive for as long as the view.
+struct table_column {
+  const void *data = nullptr;
+  std::size_t size = 0;
+  std::size_t itemsize = 0;
+  std::string format;
+};
+
+template <class T>
+static table_column make_table_column(const std::vector<T> &values) {
+  using value_type = std::conditional_t<std::is_enum_v<T>,
+                                        std::underlying_type<T>,
+                                        std::type_identity<T>>::type;
+  return {values.data(), values.size(), sizeof(T),
+          py::format_descriptor<value_type>::format()};
+}
+
+// Every figure an rtt_stats keeps, times in microseconds and loss in [0, 1].
+static py::dict make_rtt_stats_dict(const net::rtt_stats &stats) {
+  py::dict dict;
+  dict["transmitted"] = stats.transmitted();
+  dict["received"] = stats.received();
+  dict["loss_rate"] = stats.loss_rate();
+  if (stats.received()) {
+    dict["min_us"] = stats.min().count();
+    dict["avg_us"] = stats.mean();
+    dict["max_us"] = stats.max().count();
+    dict["stddev_us"] = stats.stddev();
+    dict["jitter_us"] = stats.jitter();
+    dict["p50_us"] = stats.percentile(0.5).count();
+    dict["p90_us"] = stats.percentile(0.9).count();
+    dict["p99_us"] = stats.percentile(0.99).count();
+    dict["p999_us"] = stats.percentile(0.999).count();
+  }
+  return dict;
+}
+
+static net::ping_table make_error_table(std::exception_ptr error) {
+  net::ping_table table;
+  try {
+    std::rethrow_exception(error);
+  } catch (const std::exception &e) {
+    table.error = e.what();
+  } catch (...) {
+    table.error = "Unknown error occurred";
+  }
+  return table;
+}
+
+// The compact form is a PingTable, otherwise a list of per-probe dicts.
+template <class HeaderType>
+static py::object
+make_ping_result(std::exception_ptr error,
+                 const std::vector<net::icmp_compose<HeaderType>> &composes,
+                 bool compact) {
+  if (compact) {
+    return py::cast(error ? make_error_table(error)
+                          : net::make_ping_table(composes));
+  }
+  return error ? make_error_list(error) : make_ping_list(composes);
+}
+
+template <class OriginalIPType> static constexpr std::string_view family_key() {
+  return std::is_same_v<OriginalIPType, net::use_ipv4_t> ? "v4" : "v6";
+}
+
+// A positive interval selects the pipelined mode, otherwise each probe waits
+// for its reply (or timeout) before the next one is sent. Identical pings
+// share one run, and its result while fresh, through the probe cache.
+template <class OriginalIPType>
+asio::awaitable<
+    std::vector<net::icmp_compose<net::ip_token_to_header_t<OriginalIPType>>>>
+make_ping_task(const std::string &dest, int count, int ttl, int timeout,
+               int interval) {
+  using composes_type =
+      std::vector<net::icmp_compose<net::ip_token_to_header_t<OriginalIPType>>>;
+  return net::probe_cache<composes_type>::instance().run(
+      std::format("ping/{}/{}/{}/{}/{}/{}", family_key<OriginalIPType>(),
+                  dest, count, ttl, timeout, interval),
+      [=] {
+        if (interval > 0) {
+          return net::async_ping_pipelined(
+              dest, count, ttl, std::chrono::milliseconds(timeout),
+              std::chrono::milliseconds(interval), OriginalIPType{});
+        }
+        return net::async_ping(dest, count, ttl,
+                               std::chrono::milliseconds(timeout),
+                               OriginalIPType{});
+      });
+}
+
 template <class IPType, class OriginalIPType = std::remove_cvref_t<IPType>>
-py::list tracert(const std::string &dest, int hops_count, int timeout) {
-  bool can_ping = false;
-  {
-    asio::io_context io_context;
-    auto future = asio::co_spawn(
-        io_context,
-        net::async_ping(dest, 3, 64, std::chrono::milliseconds(1000),
-                        OriginalIPType{}),
-        asio::use_future);
-    io_context.run();
-    py::list list;
-    if (future.wait_for(std::chrono::nanoseconds(0)) ==
-        std::future_status::deferred) {
-      list.append(make_status_dict(
-          "error", "error occurred, the task was not processed"));
-      return list;
-    }
-    std::vector<net::icmp_compose<net::ip_token_to_header_t<OriginalIPType>>>
-        composes;
+py::object ping(const std::string &dest, int count, int ttl, int timeout,
+                int interval, bool compact, int deadline) {
+  std::vector<net::icmp_compose<net::ip_token_to_header_t<OriginalIPType>>>
+      composes;
+  try {
+    composes = run_on_engine(within(
+        make_ping_task<OriginalIPType>(dest, count, ttl, timeout, interval),
+        deadline));
+  } catch (...) {
+    return make_ping_result(std::current_exception(), composes, compact);
+  }
+  return make_ping_result(nullptr, composes, compact);
+}
+
+template <class IPType, class OriginalIPType = std::remove_cvref_t<IPType>>
+py::object ping_async(const std::string &dest, int count, int ttl, int timeout,
+                      int interval, bool compact, int deadline) {
+  using composes_type =
+      std::vector<net::icmp_compose<net::ip_token_to_header_t<OriginalIPType>>>;
+  return net::asyncio::spawn(
+      within(
+          make_ping_task<OriginalIPType>(dest, count, ttl, timeout, interval),
+          deadline),
+      [compact](std::exception_ptr error,
+                composes_type composes) -> py::object {
+        return make_ping_result(error, composes, compact);
+      });
+}
+
+static py::dict make_ping_stats_dict(std::exception_ptr error,
+                                     const net::rtt_stats &stats) {
+  if (error) {
     try {
-      composes = future.get();
+      std::rethrow_exception(error);
     } catch (const std::exception &e) {
-      list.append(make_status_dict("error", e.what()));
-      return list;
-    }
-    for (const auto &[ipv4_hdr, icmp_hdr, length, elapsed] : composes) {
-      if (length) {
-        can_ping = true;
-        break;
-      }
+      return make_status_dict("error", e.what());
+    } catch (...) {
+      return make_status_dict("error", "Unknown error occurred");
     }
   }
+  py::dict dict = make_status_dict("success", "successfully tested");
+  dict.attr("update")(make_rtt_stats_dict(stats));
+  return dict;
+}
+
+template <class IPType, class OriginalIPType = std::remove_cvref_t<IPType>>
+py::dict ping_stats(const std::string &dest, int count, int ttl, int timeout,
+                    int interval, int deadline) {
+  try {
+    auto stats = run_on_engine(within(
+        net::async_ping_stats(dest, count, ttl,
+                              std::chrono::milliseconds(timeout),
+                              std::chrono::milliseconds(interval),
+                              OriginalIPType{}),
+        deadline));
+    return make_ping_stats_dict(nullptr, stats);
+  } catch (...) {
+    return make_ping_stats_dict(std::current_exception(), {});
+  }
+}
+
+template <class IPType, class OriginalIPType = std::remove_cvref_t<IPType>>
+py::object ping_stats_async(const std::string &dest, int count, int ttl,
+                            int timeout, int interval, int deadline) {
+  return net::asyncio::spawn(
+      within(net::async_ping_stats(dest, count, ttl,
+                                   std::chrono::milliseconds(timeout),
+                                   std::chrono::milliseconds(interval),
+                                   OriginalIPType{}),
+             deadline),
+      [](std::exception_ptr error, net::rtt_stats stats) -> py::object {
+        return make_ping_stats_dict(error, stats);
+      });
+}
+
+static py::dict make_ping_dual_dict(std::exception_ptr error,
+                                    const net::ping_dual_result &result) {
+  py::dict dict;
+  if (error) {
+    dict["ipv4"] = make_error_list(error);
+    dict["ipv6"] = make_error_list(error);
+    return dict;
+  }
+  dict["ipv4"] = result.v4_error ? make_error_list(result.v4_error)
+                                 : make_ping_list(result.v4);
+  dict["ipv6"] = result.v6_error ? make_error_list(result.v6_error)
+                                 : make_ping_list(result.v6);
+  return dict;
+}
+
+py::dict ping_dual(const std::string &dest, int count, int ttl, int timeout,
+                   int interval, int deadline) {
+  net::ping_dual_result result;
+  try {
+    result = run_on_engine(
+        within(net::async_ping_dual(dest, count, ttl,
+                                    std::chrono::milliseconds(timeout),
+                                    std::chrono::milliseconds(interval)),
+               deadline));
+  } catch (...) {
+    return make_ping_dual_dict(std::current_exception(), result);
+  }
+  return make_ping_dual_dict(nullptr, result);
+}
+
+py::object ping_dual_async(const std::string &dest, int count, int ttl,
+                           int timeout, int interval, int deadline) {
+  return net::asyncio::spawn(
+      within(net::async_ping_dual(dest, count, ttl,
+                                  std::chrono::milliseconds(timeout),
+                                  std::chrono::milliseconds(interval)),
+             deadline),
+      [](std::exception_ptr error,
+         net::ping_dual_result result) -> py::object {
+        return make_ping_dual_dict(error, result);
+      });
+}
+
+static py::list
+make_ping_many_list(std::exception_ptr error,
+                    const std::vector<net::ping_many_result> &results,
+                    bool compact) {
+  if (error) {
+    return make_error_list(error);
+  }
   py::list list;
-  asio::ip::icmp::endpoint destination;
+  for (const auto &result : results) {
+    py::dict dict = result.error.empty()
+                        ? make_status_dict("success", "successfully tested")
+                        : make_status_dict("error", result.error);
+    dict["target"] = result.target;
+    dict["results"] = std::visit(
+        [compact](const auto &composes) {
+          return make_ping_result(nullptr, composes, compact);
+        },
+        result.composes);
+    list.append(std::move(dict));
+  }
+  return list;
+}
+
+// ping_many numbers its rounds with 16-bit sequence numbers, so more would
+// alias earlier rounds.
+static void check_ping_many_count(int count) {
+  if (count > 65536) {
+    throw std::invalid_argument(
+        std::format("count must be at most 65536, got {}", count));
+  }
+}
+
+py::list ping_many(std::vector<std::string> targets, int count, int ttl,
+                   int timeout, int interval, bool compact, int deadline) {
+  check_ping_many_count(count);
+  std::vector<net::ping_many_result> results;
   try {
-    asio::io_context io_context;
-    asio::ip::icmp::resolver resolver(io_context);
-    constexpr bool is_v4 = std::is_same_v<OriginalIPType, net::use_ipv4_t>;
-    constexpr auto get_icmp = [] -> asio::ip::icmp {
-      if constexpr (is_v4) {
-        return asio::ip::icmp::v4();
-      } else {
-        return asio::ip::icmp::v6();
-      }
-    };
-    destination = *resolver.resolve(get_icmp(), dest, "").begin();
-  } catch (const std::exception &e) {
-    list.append(make_status_dict("error", e.what()));
-    return list;
-  }
-  std::size_t valid_idx = 0;
-  for (auto ttl : std::views::iota(1) | std::views::take(hops_count)) {
-    asio::io_context io_context;
-    auto future = asio::co_spawn(
-        io_context,
-        net::async_ping(dest, 3, ttl, std::chrono::milliseconds(timeout),
-                        OriginalIPType{}),
-        asio::use_future);
-    io_context.run();
-    if (future.wait_for(std::chrono::nanoseconds(0)) ==
-        std::future_status::deferred) {
-      list.append(make_status_dict("error", "timeout"));
-      continue;
-    }
-    std::vector<net::icmp_compose<net::ip_token_to_header_t<OriginalIPType>>>
-        composes;
-    try {
-      composes = future.get();
-    } catch (const std::exception &e) {
-      list.append(make_status_dict("error", e.what()));
-      continue;
-    }
+    results = run_on_engine(
+        within(net::async_ping_many(std::move(targets), count, ttl,
+                                    std::chrono::milliseconds(timeout),
+                                    std::chrono::milliseconds(interval)),
+               deadline));
+  } catch (...) {
+    return make_error_list(std::current_exception());
+  }
+  return make_ping_many_list(nullptr, results, compact);
+}
+
+py::object ping_many_async(std::vector<std::string> targets, int count,
+                           int ttl, int timeout, int interval, bool compact,
+                           int deadline) {
+  check_ping_many_count(count);
+  return net::asyncio::spawn(
+      within(net::async_ping_many(std::move(targets), count, ttl,
+                                  std::chrono::milliseconds(timeout),
+                                  std::chrono::milliseconds(interval)),
+             deadline),
+      [compact](std::exception_ptr error,
+                std::vector<net::ping_many_result> results) -> py::object {
+        return make_ping_many_list(error, results, compact);
+      });
+}
+
+static py::list make_tracert_list(std::exception_ptr error,
+                                  const std::vector<net::tracert_hop> &hops) {
+  if (error) {
+    return make_error_list(error);
+  }
+  py::list list;
+  for (const auto &hop : hops) {
     py::dict local_dict = make_status_dict("success", "successfuly tested");
-    local_dict["ttl"] = ttl;
-    asio::ip::address address;
+    local_dict["ttl"] = hop.ttl;
     py::list local_list;
-    for (const auto &[ipv4_hdr, _1, length, elapsed] : composes) {
-      if (address.is_unspecified() &&
-          !ipv4_hdr.source_address().is_unspecified()) {
-        address = ipv4_hdr.source_address();
-      }
+    py::list local_list_us;
+    for (const auto &delay : hop.delays) {
       local_list.append(
-          length
-              ? std::chrono::duration_cast<std::chrono::milliseconds>(elapsed)
-                    .count()
-              : -1);
+          delay ? std::chrono::duration_cast<std::chrono::milliseconds>(*delay)
+                      .count()
+                : -1);
+      local_list_us.append(
+          delay ? std::chrono::duration_cast<std::chrono::microseconds>(*delay)
+                      .count()
+                : -1);
     }
     local_dict["delay"] = std::move(local_list);
-    if (!address.is_unspecified()) {
-      valid_idx = ttl - 1;
-      local_dict["address"] = address.to_string();
-    } else {
-      local_dict["address"] = "timeout";
-    }
+    local_dict["delay_us"] = std::move(local_list_us);
+    local_dict["address"] =
+        hop.address.is_unspecified() ? "timeout" : hop.address.to_string();
     list.append(std::move(local_dict));
-    if (address == destination.address() ||
-        (ttl - valid_idx > 10 && !can_ping)) {
-      break;
-    }
   }
   return list;
 }
 
-py::dict tcping(const std::string &host, std::uint16_t port, int timeout) {
-  asio::io_context io_context;
-  auto future = asio::co_spawn(
-      io_context,
-      net::async_tcping(host, port, std::chrono::milliseconds(timeout)),
-      asio::use_future);
-  io_context.run();
-  if (future.wait_for(std::chrono::nanoseconds(0)) ==
-      std::future_status::deferred) {
-    py::dict dict =
-        make_status_dict("error", "error occurred, the task was not processed");
-    return dict;
-  }
+// Shared through the probe cache like make_ping_task.
+template <class OriginalIPType>
+asio::awaitable<std::vector<net::tracert_hop>>
+make_tracert_task(const std::string &dest, int hops_count, int timeout,
+                  int window) {
+  return net::probe_cache<std::vector<net::tracert_hop>>::instance().run(
+      std::format("tracert/{}/{}/{}/{}/{}", family_key<OriginalIPType>(),
+                  dest, hops_count, timeout, window),
+      [=] {
+        return net::async_tracert(dest, hops_count, 3,
+                                  std::chrono::milliseconds(timeout), window,
+                                  OriginalIPType{});
+      });
+}
+
+template <class IPType, class OriginalIPType = std::remove_cvref_t<IPType>>
+py::list tracert(const std::string &dest, int hops_count, int timeout,
+                 int window, int deadline) {
+  std::vector<net::tracert_hop> hops;
   try {
-    auto delay = future.get();
+    hops = run_on_engine(within(make_tracert_task<OriginalIPType>(
+                                    dest, hops_count, timeout, window),
+                                deadline));
+  } catch (...) {
+    return make_error_list(std::current_exception());
+  }
+  return make_tracert_list(nullptr, hops);
+}
+
+template <class IPType, class OriginalIPType = std::remove_cvref_t<IPType>>
+py::object tracert_async(const std::string &dest, int hops_count, int timeout,
+                         int window, int deadline) {
+  return net::asyncio::spawn(
+      within(make_tracert_task<OriginalIPType>(dest, hops_count, timeout,
+                                               window),
+             deadline),
+      [](std::exception_ptr error,
+         std::vector<net::tracert_hop> hops) -> py::object {
+        return make_tracert_list(error, hops);
+      });
+}
+
+static py::dict make_tcping_dict(std::exception_ptr error,
+                                 std::chrono::milliseconds delay) {
+  if (!error) {
     py::dict dict = make_status_dict("success", "successfully tested");
     dict["value"] = delay.count();
     return dict;
+  }
+  try {
+    std::rethrow_exception(error);
   } catch (const std::exception &e) {
-    py::dict dict = make_status_dict("error", e.what());
-    return dict;
+    return make_status_dict("error", e.what());
   } catch (...) {
-    py::dict dict = make_status_dict("error", "Unknown error occurred");
-    return dict;
+    return make_status_dict("error", "Unknown error occurred");
+  }
+}
+
+py::dict tcping(const std::string &host, std::uint16_t port, int timeout,
+                int deadline) {
+  try {
+    auto delay = run_on_engine(within(
+        net::async_tcping(host, port, std::chrono::milliseconds(timeout)),
+        deadline));
+    return make_tcping_dict(nullptr, delay);
+  } catch (...) {
+    return make_tcping_dict(std::current_exception(), {});
   }
 }
 
+py::object tcping_async(const std::string &host, std::uint16_t port,
+                        int timeout, int deadline) {
+  return net::asyncio::spawn(
+      within(net::async_tcping(host, port, std::chrono::milliseconds(timeout)),
+             deadline),
+      [](std::exception_ptr error,
+         std::chrono::milliseconds delay) -> py::object {
+        return make_tcping_dict(error, delay);
+      });
+}
+
+static py::dict
+make_tcping_stats_dict(std::exception_ptr error,
+                       const std::vector<net::tcping_endpoint_stats> &stats) {
+  if (error) {
+    try {
+      std::rethrow_exception(error);
+    } catch (const std::exception &e) {
+      return make_status_dict("error", e.what());
+    } catch (...) {
+      return make_status_dict("error", "Unknown error occurred");
+    }
+  }
+  py::dict dict = make_status_dict("success", "successfully tested");
+  py::list endpoints;
+  for (const auto &endpoint : stats) {
+    py::dict local_dict;
+    local_dict["address"] = endpoint.endpoint.address().to_string();
+    local_dict["port"] = endpoint.endpoint.port();
+    local_dict["attempts"] = endpoint.attempts;
+    local_dict["successes"] = endpoint.rtt.received();
+    local_dict["failures"] = endpoint.rtt.lost();
+    local_dict["wins"] = endpoint.wins;
+    local_dict["error"] =
+        endpoint.last_error ? endpoint.last_error.message() : std::string();
+    local_dict["stats"] = make_rtt_stats_dict(endpoint.rtt);
+    endpoints.append(std::move(local_dict));
+  }
+  dict["endpoints"] = std::move(endpoints);
+  return dict;
+}
+
+static asio::awaitable<std::vector<net::tcping_endpoint_stats>>
+make_tcping_stats_task(const std::string &host, std::uint16_t port, int count,
+                       int timeout, int interval, int attempt_delay) {
+  return net::async_tcping_stats(host, port, count,
+                                 std::chrono::milliseconds(timeout),
+                                 std::chrono::milliseconds(interval),
+                                 std::chrono::milliseconds(attempt_delay));
+}
+
+py::dict tcping_stats(const std::string &host, std::uint16_t port, int count,
+                      int timeout, int interval, int attempt_delay,
+                      int deadline) {
+  try {
+    auto stats = run_on_engine(
+        within(make_tcping_stats_task(host, port, count, timeout, interval,
+                                      attempt_delay),
+               deadline));
+    return make_tcping_stats_dict(nullptr, stats);
+  } catch (...) {
+    return make_tcping_stats_dict(std::current_exception(), {});
+  }
+}
+
+py::object tcping_stats_async(const std::string &host, std::uint16_t port,
+                              int count, int timeout, int interval,
+                              int attempt_delay, int deadline) {
+  return net::asyncio::spawn(
+      within(make_tcping_stats_task(host, port, count, timeout, interval,
+                                    attempt_delay),
+             deadline),
+      [](std::exception_ptr error,
+         std::vector<net::tcping_endpoint_stats> stats) -> py::object {
+        return make_tcping_stats_dict(error, stats);
+      });
+}
+
+static py::dict make_port_scan_dict(std::exception_ptr error,
+                                    const net::port_scan_result &result) {
+  if (error) {
+    try {
+      std::rethrow_exception(error);
+    } catch (const std::exception &e) {
+      return make_status_dict("error", e.what());
+    } catch (...) {
+      return make_status_dict("error", "Unknown error occurred");
+    }
+  }
+  py::dict dict = make_status_dict("success", "successfully scanned");
+  dict["address"] = result.address.to_string();
+  py::list open;
+  py::list open_us;
+  for (const auto &port : result.open_ports) {
+    open.append(port.port);
+    open_us.append(port.connect_time.count());
+  }
+  py::list closed;
+  py::list filtered;
+  py::list failed;
+  py::list unscanned;
+  for (std::size_t i = 0; i < result.states.size(); ++i) {
+    auto port = static_cast<std::uint16_t>(result.first_port + i);
+    switch (result.states[i]) {
+    case net::port_state::open:
+      break;
+    case net::port_state::closed:
+      closed.append(port);
+      break;
+    case net::port_state::filtered:
+      filtered.append(port);
+      break;
+    case net::port_state::failed:
+      failed.append(port);
+      break;
+    case net::port_state::unscanned:
+      unscanned.append(port);
+      break;
+    }
+  }
+  dict["open"] = std::move(open);
+  dict["open_us"] = std::move(open_us);
+  dict["closed"] = std::move(closed);
+  dict["filtered"] = std::move(filtered);
+  dict["failed"] = std::move(failed);
+  dict["unscanned"] = std::move(unscanned);
+  return dict;
+}
+
+static asio::awaitable<net::port_scan_result>
+make_port_scan_task(const std::string &host, std::uint16_t first_port,
+                    std::uint16_t last_port, std::size_t max_in_flight,
+                    int timeout, int deadline) {
+  return net::async_port_scan(host, first_port, last_port, max_in_flight,
+                              std::chrono::milliseconds(timeout),
+                              std::chrono::milliseconds(deadline));
+}
+
+py::dict port_scan(const std::string &host, std::uint16_t first_port,
+                   std::uint16_t last_port, std::size_t max_in_flight,
+                   int timeout, int deadline) {
+  try {
+    auto result = run_on_engine(make_port_scan_task(
+        host, first_port, last_port, max_in_flight, timeout, deadline));
+    return make_port_scan_dict(nullptr, result);
+  } catch (...) {
+    return make_port_scan_dict(std::current_exception(), {});
+  }
+}
+
+py::object port_scan_async(const std::string &host, std::uint16_t first_port,
+                           std::uint16_t last_port, std::size_t max_in_flight,
+                           int timeout, int deadline) {
+  return net::asyncio::spawn(
+      make_port_scan_task(host, first_port, last_port, max_in_flight, timeout,
+                          deadline),
+      [](std::exception_ptr error,
+         net::port_scan_result result) -> py::object {
+        return make_port_scan_dict(error, result);
+      });
+}
+
+using sweep_replies =
+    std::vector<std::pair<asio::ip::address, std::chrono::microseconds>>;
+
+static py::dict make_sweep_dict(std::exception_ptr error,
+                                const net::sweep_summary &summary,
+                                const sweep_replies *replies) {
+  if (error) {
+    try {
+      std::rethrow_exception(error);
+    } catch (const std::exception &e) {
+      return make_status_dict("error", e.what());
+    } catch (...) {
+      return make_status_dict("error", "Unknown error occurred");
+    }
+  }
+  py::dict dict = make_status_dict("success", "successfully swept");
+  dict["addresses"] = summary.addresses;
+  dict["sent"] = summary.sent;
+  dict["received"] = summary.received;
+  if (replies) {
+    py::list list;
+    for (const auto &[address, rtt] : *replies) {
+      py::dict local_dict;
+      local_dict["address"] = address.to_string();
+      local_dict["time_us"] = rtt.count();
+      list.append(std::move(local_dict));
+    }
+    dict["replies"] = std::move(list);
+  }
+  return dict;
+}
+
+// Without a callback the replies are collected and returned at the end.
+// With one, each reply is handed over as it arrives and nothing is kept.
+py::dict sweep(const std::string &cidr, double rate, double burst,
+               std::size_t window, int timeout, py::object on_reply,
+               int deadline) {
+  auto replies = std::make_shared<sweep_replies>();
+  // run_on_engine blocks until the sweep is over, so the callback outlives
+  // every call made through this pointer.
+  const py::object *callback = on_reply.is_none() ? nullptr : &on_reply;
+  auto handler = [replies, callback](const asio::ip::address &address,
+                                     std::chrono::microseconds rtt) {
+    if (!callback) {
+      replies->emplace_back(address, rtt);
+      return;
+    }
+    py::gil_scoped_acquire acquire;
+    try {
+      (*callback)(address.to_string(), rtt.count());
+    } catch (py::error_already_set &e) {
+      e.discard_as_unraisable("sweep on_reply");
+    }
+  };
+  try {
+    auto summary = run_on_engine(
+        within(net::async_sweep(cidr, rate, burst, window,
+                                std::chrono::milliseconds(timeout), handler),
+               deadline));
+    return make_sweep_dict(nullptr, summary, callback ? nullptr : &*replies);
+  } catch (...) {
+    return make_sweep_dict(std::current_exception(), {}, nullptr);
+  }
+}
+
+py::object sweep_async(const std::string &cidr, double rate, double burst,
+                       std::size_t window, int timeout, py::object on_reply,
+                       int deadline) {
+  auto replies = std::make_shared<sweep_replies>();
+  std::optional<net::asyncio::loop_callback> callback;
+  if (!on_reply.is_none()) {
+    callback.emplace(std::move(on_reply));
+  }
+  bool streaming = callback.has_value();
+  auto handler = [replies, callback](const asio::ip::address &address,
+                                     std::chrono::microseconds rtt) {
+    if (callback) {
+      (*callback)(address.to_string(), rtt.count());
+    } else {
+      replies->emplace_back(address, rtt);
+    }
+  };
+  return net::asyncio::spawn(
+      within(net::async_sweep(cidr, rate, burst, window,
+                              std::chrono::milliseconds(timeout),
+                              std::move(handler)),
+             deadline),
+      [replies, streaming](std::exception_ptr error,
+                           net::sweep_summary summary) -> py::object {
+        return make_sweep_dict(error, summary,
+                               streaming ? nullptr : replies.get());
+      });
+}
+
+void set_icmp_transport(const std::string &name) {
+  net::icmp_transport transport;
+  if (name == "auto") {
+    transport = net::icmp_transport::automatic;
+  } else if (name == "raw") {
+    transport = net::icmp_transport::raw;
+  } else if (name == "datagram") {
+    transport = net::icmp_transport::datagram;
+  } else {
+    throw std::invalid_argument(
+        std::format("unknown icmp transport: {}", name));
+  }
+  net::icmp_transport_preference().store(transport,
+                                         std::memory_order_relaxed);
+}
+
+void set_kernel_timestamps(bool enabled) {
+  net::icmp_kernel_timestamps().store(enabled, std::memory_order_relaxed);
+}
+
+void set_batched_io(bool enabled) {
+  net::icmp_batched_io().store(enabled, std::memory_order_relaxed);
+}
+
+// Every engine thread has its own dispatchers; these add them up.
+template <class IPType> static net::icmp_io_stats total_io_stats() {
+  net::icmp_io_stats total;
+  net::engine::instance().for_each_context([&](asio::io_context &context) {
+    if (!asio::has_service<net::icmp_dispatcher<IPType>>(context)) {
+      return;
+    }
+    auto stats =
+        asio::use_service<net::icmp_dispatcher<IPType>>(context).io_stats();
+    total.packets_sent += stats.packets_sent;
+    total.send_calls += stats.send_calls;
+    total.packets_received += stats.packets_received;
+    total.receive_calls += stats.receive_calls;
+  });
+  return total;
+}
+
+template <class IPType> static py::dict make_io_stats_dict() {
+  auto stats = total_io_stats<IPType>();
+  py::dict dict;
+  dict["packets_sent"] = stats.packets_sent;
+  dict["send_calls"] = stats.send_calls;
+  dict["packets_received"] = stats.packets_received;
+  dict["receive_calls"] = stats.receive_calls;
+  return dict;
+}
+
+py::dict icmp_io_stats() {
+  py::dict dict;
+  dict["ipv4"] = make_io_stats_dict<net::use_ipv4_t>();
+  dict["ipv6"] = make_io_stats_dict<net::use_ipv6_t>();
+  return dict;
+}
+
+void set_icmp_filter(bool enabled) {
+  net::icmp_filter_enabled().store(enabled, std::memory_order_relaxed);
+}
+
+py::dict icmp_packets_received() {
+  py::dict dict;
+  dict["ipv4"] = total_io_stats<net::use_ipv4_t>().packets_received;
+  dict["ipv6"] = total_io_stats<net::use_ipv6_t>().packets_received;
+  return dict;
+}
+
+void set_engine_threads(std::size_t count) {
+  net::engine::instance().set_thread_count(count);
+}
+
+py::dict engine_threads() {
+  auto &engine = net::engine::instance();
+  py::dict dict;
+  dict["threads"] = engine.thread_count();
+  dict["max_threads"] = engine.max_threads();
+  return dict;
+}
+
+static py::dict make_dns_lookup_dict(std::exception_ptr error,
+                                     const net::dns_lookup &lookup) {
+  if (error) {
+    try {
+      std::rethrow_exception(error);
+    } catch (const std::exception &e) {
+      return make_status_dict("error", e.what());
+    } catch (...) {
+      return make_status_dict("error", "Unknown error occurred");
+    }
+  }
+  bool resolved = !lookup.v4.addresses.empty() || !lookup.v6.addresses.empty();
+  // Names each query that failed, e.g. "a: Host not found; aaaa: Timed out".
+  std::string failure;
+  for (auto [type, answer] : {std::pair{"a", &lookup.v4},
+                              std::pair{"aaaa", &lookup.v6}}) {
+    if (answer->error) {
+      failure += failure.empty() ? "" : "; ";
+      failure += std::string(type) + ": " + answer->error.message();
+    }
+  }
+  py::dict dict =
+      resolved ? make_status_dict("success", "successfully resolved")
+               : make_status_dict("error", failure.empty() ? "no addresses"
+                                                           : failure);
+  auto add_answer = [&dict](const std::string &key,
+                            const net::dns_answer &answer) {
+    py::list addresses;
+    for (const auto &address : answer.addresses) {
+      addresses.append(address.to_string());
+    }
+    dict[py::str(key)] = std::move(addresses);
+    dict[py::str(key + "_ttl")] = answer.ttl.count();
+    dict[py::str(key + "_error")] =
+        answer.error ? answer.error.message() : std::string();
+  };
+  add_answer("a", lookup.v4);
+  add_answer("aaaa", lookup.v6);
+  return dict;
+}
+
+// An empty server asks the system's first name server.
+static asio::awaitable<net::dns_lookup>
+make_dns_lookup_task(std::string host, std::string server, std::uint16_t port,
+                     int timeout) {
+  asio::ip::udp::endpoint endpoint = net::default_name_server();
+  if (!server.empty()) {
+    endpoint = {asio::ip::make_address(server), port};
+  }
+  co_return co_await net::async_dns_lookup(
+      std::move(host), endpoint, std::chrono::milliseconds(timeout));
+}
+
+py::dict dns_lookup(const std::string &host, const std::string &server,
+                    std::uint16_t port, int timeout, int deadline) {
+  try {
+    auto lookup = run_on_engine(
+        within(make_dns_lookup_task(host, server, port, timeout), deadline));
+    return make_dns_lookup_dict(nullptr, lookup);
+  } catch (...) {
+    return make_dns_lookup_dict(std::current_exception(), {});
+  }
+}
+
+py::object dns_lookup_async(const std::string &host, const std::string &server,
+                            std::uint16_t port, int timeout, int deadline) {
+  return net::asyncio::spawn(
+      within(make_dns_lookup_task(host, server, port, timeout), deadline),
+      [](std::exception_ptr error, net::dns_lookup lookup) -> py::object {
+        return make_dns_lookup_dict(error, lookup);
+      });
+}
+
+py::dict dns_cache_stats() {
+  auto stats = net::dns_cache::instance().stats();
+  py::dict dict;
+  dict["hits"] = stats.hits;
+  dict["misses"] = stats.misses;
+  dict["entries"] = stats.entries;
+  return dict;
+}
+
+void clear_dns_cache() { net::dns_cache::instance().clear(); }
+
+void set_probe_cache(int freshness, std::size_t capacity) {
+  net::probe_cache_config::instance().configure(
+      std::chrono::milliseconds(freshness), capacity);
+}
+
+py::dict probe_cache_stats() {
+  auto &config = net::probe_cache_config::instance();
+  auto stats = config.stats();
+  py::dict dict;
+  dict["hits"] = stats.hits;
+  dict["joins"] = stats.joins;
+  dict["misses"] = stats.misses;
+  dict["freshness"] = config.freshness().count();
+  dict["capacity"] = config.capacity();
+  return dict;
+}
+
+void clear_probe_cache() { net::probe_cache_config::instance().clear(); }
+
+static py::dict make_icmp_metrics_dict(const net::icmp_metrics &metrics) {
+  py::dict dict;
+  dict["probes_sent"] = metrics.probes_sent.value();
+  dict["replies_matched"] = metrics.replies_matched.value();
+  dict["replies_unmatched"] = metrics.replies_unmatched.value();
+  dict["checksum_failures"] = metrics.checksum_failures.value();
+  dict["probe_timeouts"] = metrics.probe_timeouts.value();
+  dict["sockets_opened"] = metrics.sockets_opened.value();
+  dict["replies_queued"] = metrics.replies_queued.value();
+  return dict;
+}
+
+// Buckets are (upper bound in us, samples at most that long) pairs; the
+// count covers the ones beyond the last bound too.
+static py::dict make_histogram_dict(const net::latency_histogram &histogram) {
+  auto snapshot = histogram.read();
+  py::list buckets;
+  for (std::size_t i = 0; i < net::latency_histogram::bounds_us.size(); ++i) {
+    buckets.append(py::make_tuple(net::latency_histogram::bounds_us[i],
+                                  snapshot.cumulative[i]));
+  }
+  py::dict dict;
+  dict["count"] = snapshot.count();
+  dict["sum_us"] = static_cast<double>(snapshot.sum_ns) / 1000;
+  dict["buckets"] = std::move(buckets);
+  return dict;
+}
+
+py::dict metrics() {
+  const auto &metrics = net::module_metrics::instance();
+  py::dict icmp;
+  icmp["ipv4"] = make_icmp_metrics_dict(metrics.icmp_v4);
+  icmp["ipv6"] = make_icmp_metrics_dict(metrics.icmp_v6);
+  py::dict stages;
+  for (std::size_t i = 0; i < net::probe_stage_names.size(); ++i) {
+    stages[py::str(std::string(net::probe_stage_names[i]))] =
+        make_histogram_dict(metrics.stages[i]);
+  }
+  py::dict dict;
+  dict["icmp"] = std::move(icmp);
+  dict["stages"] = std::move(stages);
+  dict["completions_pending"] = metrics.completions_pending.value();
+  return dict;
+}
+
+std::string metrics_prometheus() {
+  return net::prometheus_text(net::module_metrics::instance());
+}
+
 PYBIND11_MODULE(network_utils_externel_cpp, m) {
   m.doc() = "A Cpp network utils module for python";
-  m.def("ping", &ping<decltype(net::use_ipv4)>, "ping the destination");
+
+  // Start the shared engine at import time and stop it before the
+  // interpreter tears down, so its threads never outlive Python.
+  net::engine::instance();
+  net::load_resolver_files();
+  py::module_::import("atexit").attr("register")(py::cpp_function([] {
+    net::asyncio::interpreter_alive().store(false, std::memory_order_release);
+    py::gil_scoped_release release;
+    net::engine::instance().stop();
+  }));
+
+  py::class_<table_column>(m, "TableColumn", py::buffer_protocol())
+      .def_buffer([](const table_column &column) {
+        return py::buffer_info(
+            const_cast<void *>(column.data),
+            static_cast<py::ssize_t>(column.itemsize), column.format, 1,
+            {static_cast<py::ssize_t>(column.size)},
+            {static_cast<py::ssize_t>(column.itemsize)}, true);
+      })
+      .def("__len__", [](const table_column &column) { return column.size; });
+
+  py::class_<net::ping_table>(m, "PingTable")
+      .def("__len__",
+           [](const net::ping_table &table) { return table.status.size(); })
+      .def_property_readonly("status",
+                             [](const net::ping_table &table) {
+                               return table.error.empty() ? "success"
+                                                          : "error";
+                             })
+      .def_readonly("message", &net::ping_table::error)
+      .def_property_readonly("address",
+                             [](const net::ping_table &table) {
+                               return table.address.is_unspecified()
+                                          ? std::string()
+                                          : table.address.to_string();
+                             })
+      .def_property_readonly("transmitted",
+                             [](const net::ping_table &table) {
+                               return table.stats.transmitted();
+                             })
+      .def_property_readonly(
+          "received",
+          [](const net::ping_table &table) { return table.stats.received(); })
+      .def_property_readonly("loss",
+                             [](const net::ping_table &table) {
+                               return 100 * table.stats.loss_rate();
+                             })
+      .def_property_readonly("min_us",
+                             [](const net::ping_table &table) {
+                               return table.stats.min().count();
+                             })
+      .def_property_readonly(
+          "avg_us",
+          [](const net::ping_table &table) { return table.stats.mean(); })
+      .def_property_readonly("max_us",
+                             [](const net::ping_table &table) {
+                               return table.stats.max().count();
+                             })
+      .def_property_readonly(
+          "mdev_us",
+          [](const net::ping_table &table) { return table.stats.stddev(); })
+      .def_property_readonly("stats",
+                             [](const net::ping_table &table) {
+                               return make_rtt_stats_dict(table.stats);
+                             })
+      .def_property_readonly(
+          "rtt_us",
+          [](const net::ping_table &table) {
+            return make_table_column(table.rtt_us);
+          },
+          py::keep_alive<0, 1>())
+      .def_property_readonly(
+          "sequence",
+          [](const net::ping_table &table) {
+            return make_table_column(table.sequence);
+          },
+          py::keep_alive<0, 1>())
+      .def_property_readonly(
+          "ttl",
+          [](const net::ping_table &table) {
+            return make_table_column(table.ttl);
+          },
+          py::keep_alive<0, 1>())
+      .def_property_readonly(
+          "bytes",
+          [](const net::ping_table &table) {
+            return make_table_column(table.bytes);
+          },
+          py::keep_alive<0, 1>())
+      .def_property_readonly(
+          "codes",
+          [](const net::ping_table &table) {
+            return make_table_column(table.status);
+          },
+          py::keep_alive<0, 1>());
+
+  m.def("ping", &ping<decltype(net::use_ipv4)>, "ping the destination",
+        py::arg("dest"), py::arg("count"), py::arg("ttl"), py::arg("timeout"),
+        py::arg("interval") = 0, py::arg("compact") = false,
+        py::arg("deadline") = 0);
   m.def("pingv6", &ping<decltype(net::use_ipv6)>,
-        "ping the destination in ipv6");
+        "ping the destination in ipv6", py::arg("dest"), py::arg("count"),
+        py::arg("ttl"), py::arg("timeout"), py::arg("interval") = 0,
+        py::arg("compact") = false, py::arg("deadline") = 0);
+  m.def("ping_stats", &ping_stats<decltype(net::use_ipv4)>,
+        "ping the destination keeping only running statistics, for any count "
+        "in constant memory",
+        py::arg("dest"), py::arg("count"), py::arg("ttl"), py::arg("timeout"),
+        py::arg("interval") = 0, py::arg("deadline") = 0);
+  m.def("ping_stats_async", &ping_stats_async<decltype(net::use_ipv4)>,
+        "ping_stats, returning an asyncio future", py::arg("dest"),
+        py::arg("count"), py::arg("ttl"), py::arg("timeout"),
+        py::arg("interval") = 0, py::arg("deadline") = 0);
+  m.def("pingv6_stats", &ping_stats<decltype(net::use_ipv6)>,
+        "ping_stats in ipv6", py::arg("dest"), py::arg("count"),
+        py::arg("ttl"), py::arg("timeout"), py::arg("interval") = 0,
+        py::arg("deadline") = 0);
+  m.def("pingv6_stats_async", &ping_stats_async<decltype(net::use_ipv6)>,
+        "ping_stats in ipv6, returning an asyncio future", py::arg("dest"),
+        py::arg("count"), py::arg("ttl"), py::arg("timeout"),
+        py::arg("interval") = 0, py::arg("deadline") = 0);
+  m.def("ping_dual", &ping_dual,
+        "ping the ipv4 and ipv6 addresses of the destination concurrently",
+        py::arg("dest"), py::arg("count"), py::arg("ttl"), py::arg("timeout"),
+        py::arg("interval") = 0, py::arg("deadline") = 0);
+  m.def("ping_dual_async", &ping_dual_async,
+        "ping the ipv4 and ipv6 addresses of the destination concurrently, "
+        "returning an asyncio future",
+        py::arg("dest"), py::arg("count"), py::arg("ttl"), py::arg("timeout"),
+        py::arg("interval") = 0, py::arg("deadline") = 0);
+  m.def("ping_many", &ping_many,
+        "ping many destinations over one socket per address family",
+        py::arg("targets"), py::arg("count"), py::arg("ttl"),
+        py::arg("timeout"), py::arg("interval") = 0,
+        py::arg("compact") = false, py::arg("deadline") = 0);
+  m.def("ping_many_async", &ping_many_async,
+        "ping many destinations, returning an asyncio future",
+        py::arg("targets"), py::arg("count"), py::arg("ttl"),
+        py::arg("timeout"), py::arg("interval") = 0,
+        py::arg("compact") = false, py::arg("deadline") = 0);
   m.def("tracert", &tracert<decltype(net::use_ipv4)>,
-        "tracert the destination");
+        "tracert the destination", py::arg("dest"), py::arg("hops_count"),
+        py::arg("timeout"), py::arg("window") = 0, py::arg("deadline") = 0);
   m.def("tracertv6", &tracert<decltype(net::use_ipv6)>,
-        "tracert the destination in ipv6");
-  m.def("tcping", &tcping, "tcping a host");
+        "tracert the destination in ipv6", py::arg("dest"),
+        py::arg("hops_count"), py::arg("timeout"), py::arg("window") = 0,
+        py::arg("deadline") = 0);
+  m.def("tracert_async", &tracert_async<decltype(net::use_ipv4)>,
+        "tracert the destination, returning an asyncio future",
+        py::arg("dest"), py::arg("hops_count"), py::arg("timeout"),
+        py::arg("window") = 0, py::arg("deadline") = 0);
+  m.def("tracertv6_async", &tracert_async<decltype(net::use_ipv6)>,
+        "tracert the destination in ipv6, returning an asyncio future",
+        py::arg("dest"), py::arg("hops_count"), py::arg("timeout"),
+        py::arg("window") = 0, py::arg("deadline") = 0);
+  m.def("tcping", &tcping, "tcping a host", py::arg("host"), py::arg("port"),
+        py::arg("timeout"), py::arg("deadline") = 0);
+  m.def("ping_async", &ping_async<decltype(net::use_ipv4)>,
+        "ping the destination, returning an asyncio future", py::arg("dest"),
+        py::arg("count"), py::arg("ttl"), py::arg("timeout"),
+        py::arg("interval") = 0, py::arg("compact") = false,
+        py::arg("deadline") = 0);
+  m.def("pingv6_async", &ping_async<decltype(net::use_ipv6)>,
+        "ping the destination in ipv6, returning an asyncio future",
+        py::arg("dest"), py::arg("count"), py::arg("ttl"), py::arg("timeout"),
+        py::arg("interval") = 0, py::arg("compact") = false,
+        py::arg("deadline") = 0);
+  m.def("tcping_async", &tcping_async,
+        "tcping a host, returning an asyncio future", py::arg("host"),
+        py::arg("port"), py::arg("timeout"), py::arg("deadline") = 0);
+  m.def("tcping_stats", &tcping_stats,
+        "connect to every address of a host over several rounds and report "
+        "per-address connect times in microseconds",
+        py::arg("host"), py::arg("port"), py::arg("count") = 4,
+        py::arg("timeout") = 1000, py::arg("interval") = 1000,
+        py::arg("attempt_delay") = 0, py::arg("deadline") = 0);
+  m.def("tcping_stats_async", &tcping_stats_async,
+        "tcping_stats, returning an asyncio future", py::arg("host"),
+        py::arg("port"), py::arg("count") = 4, py::arg("timeout") = 1000,
+        py::arg("interval") = 1000, py::arg("attempt_delay") = 0,
+        py::arg("deadline") = 0);
+  m.def("port_scan", &port_scan,
+        "connect to a range of tcp ports concurrently and sort them into "
+        "open, closed, filtered, failed and unscanned",
+        py::arg("host"), py::arg("first_port"), py::arg("last_port"),
+        py::arg("max_in_flight") = 256, py::arg("timeout") = 1000,
+        py::arg("deadline") = 0);
+  m.def("port_scan_async", &port_scan_async,
+        "port_scan, returning an asyncio future", py::arg("host"),
+        py::arg("first_port"), py::arg("last_port"),
+        py::arg("max_in_flight") = 256, py::arg("timeout") = 1000,
+        py::arg("deadline") = 0);
+  m.def("sweep", &sweep,
+        "ping every address of a cidr prefix at a limited rate, calling "
+        "on_reply(address, time_us) for each reply if given",
+        py::arg("cidr"), py::arg("rate") = 100.0, py::arg("burst") = 10.0,
+        py::arg("window") = 256, py::arg("timeout") = 1000,
+        py::arg("on_reply") = py::none(), py::arg("deadline") = 0);
+  m.def("sweep_async", &sweep_async,
+        "sweep, returning an asyncio future; on_reply is called on the loop",
+        py::arg("cidr"), py::arg("rate") = 100.0, py::arg("burst") = 10.0,
+        py::arg("window") = 256, py::arg("timeout") = 1000,
+        py::arg("on_reply") = py::none(), py::arg("deadline") = 0);
+  m.def("set_icmp_transport", &set_icmp_transport,
+        "choose 'auto', 'raw' or 'datagram' icmp sockets for sockets opened "
+        "from now on",
+        py::arg("name"));
+  m.def("set_icmp_filter", &set_icmp_filter,
+        "attach a kernel filter for our own replies to raw icmp sockets "
+        "opened from now on",
+        py::arg("enabled"));
+  m.def("set_kernel_timestamps", &set_kernel_timestamps,
+        "time replies with kernel receive timestamps on icmp sockets opened "
+        "from now on",
+        py::arg("enabled"));
+  m.def("icmp_packets_received", &icmp_packets_received,
+        "icmp packets that reached userspace, per address family");
+  m.def("set_batched_io", &set_batched_io,
+        "send and read icmp packets in batches (sendmmsg/recvmmsg)",
+        py::arg("enabled"));
+  m.def("icmp_io_stats", &icmp_io_stats,
+        "icmp packets and system calls per direction and address family");
+  m.def("set_engine_threads", &set_engine_threads,
+        "spread probes started from now on over this many engine threads, "
+        "each with its own sockets; at most one per core",
+        py::arg("count"));
+  m.def("engine_threads", &engine_threads,
+        "the engine threads probes are spread over, and the most it can use");
+  m.def("dns_lookup", &dns_lookup,
+        "query the A and AAAA records of a host in parallel",
+        py::arg("host"), py::arg("server") = "", py::arg("port") = 53,
+        py::arg("timeout") = 2000, py::arg("deadline") = 0);
+  m.def("dns_lookup_async", &dns_lookup_async,
+        "query the A and AAAA records of a host, returning an asyncio future",
+        py::arg("host"), py::arg("server") = "", py::arg("port") = 53,
+        py::arg("timeout") = 2000, py::arg("deadline") = 0);
+  m.def("dns_cache_stats", &dns_cache_stats,
+        "hits, misses and entries of the shared dns cache");
+  m.def("clear_dns_cache", &clear_dns_cache,
+        "drop every name from the shared dns cache");
+  m.def("set_probe_cache", &set_probe_cache,
+        "set how long identical ping and tracert results are reused, in ms, "
+        "and how many are kept; 0 only merges probes in flight",
+        py::arg("freshness") = 5000, py::arg("capacity") = 64);
+  m.def("probe_cache_stats", &probe_cache_stats,
+        "hits, joins and misses of the shared probe cache, and its settings");
+  m.def("clear_probe_cache", &clear_probe_cache,
+        "drop every cached ping and tracert result");
+  m.def("metrics", &metrics,
+        "probe counters, queue depths and per-stage timings since import");
+  m.def("metrics_prometheus", &metrics_prometheus,
+        "the metrics in the prometheus text format, for an exporter to "
+        "serve");
 }
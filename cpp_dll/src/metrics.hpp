@@ -0,0 +1,268 @@
+#ifndef METRICS_HPP
+#define METRICS_HPP
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <format>
+#include <iterator>
+#include <string>
+#include <string_view>
+#include <type_traits>
+
+#include "icmp_utils.hpp"
+
+namespace net {
+namespace detail {
+// Metrics are split into stripes on separate cache lines, and each thread
+// always adds to the same stripe, so engine threads counting at the same time
+// do not contend on one line. Reads add the stripes up.
+inline constexpr std::size_t metric_stripes = 16;
+
+inline std::size_t metric_stripe() noexcept {
+  static std::atomic<std::size_t> next{0};
+  thread_local const std::size_t stripe =
+      next.fetch_add(1, std::memory_order_relaxed) % metric_stripes;
+  return stripe;
+}
+} // namespace detail
+
+// A count that only goes up.
+class metric_counter {
+public:
+  void add(std::uint64_t n = 1) noexcept {
+    stripes_[detail::metric_stripe()].value.fetch_add(
+        n, std::memory_order_relaxed);
+  }
+
+  std::uint64_t value() const noexcept {
+    std::uint64_t total = 0;
+    for (const auto &stripe : stripes_) {
+      total += stripe.value.load(std::memory_order_relaxed);
+    }
+    return total;
+  }
+
+private:
+  struct alignas(64) stripe {
+    std::atomic<std::uint64_t> value{0};
+  };
+
+  std::array<stripe, detail::metric_stripes> stripes_;
+};
+
+// A level that goes up and down, such as a queue depth. A stripe may go
+// negative when the thread that takes an item is not the one that added it;
+// only the sum means anything.
+class metric_gauge {
+public:
+  void add(std::int64_t n = 1) noexcept {
+    stripes_[detail::metric_stripe()].value.fetch_add(
+        n, std::memory_order_relaxed);
+  }
+
+  void sub(std::int64_t n = 1) noexcept { add(-n); }
+
+  std::int64_t value() const noexcept {
+    std::int64_t total = 0;
+    for (const auto &stripe : stripes_) {
+      total += stripe.value.load(std::memory_order_relaxed);
+    }
+    return total;
+  }
+
+private:
+  struct alignas(64) stripe {
+    std::atomic<std::int64_t> value{0};
+  };
+
+  std::array<stripe, detail::metric_stripes> stripes_;
+};
+
+// Durations counted into fixed buckets, as a Prometheus histogram: from
+// 10 us, the kernel's own cost for a system call or so, up to 5 s, the
+// longest a probe or a lookup should take.
+class latency_histogram {
+public:
+  static constexpr std::array<std::uint64_t, 18> bounds_us{
+      10,     25,     50,      100,     250,     500,
+      1000,   2500,   5000,    10000,   25000,   50000,
+      100000, 250000, 500000,  1000000, 2500000, 5000000};
+  // The last bucket is +Inf.
+  static constexpr std::size_t bucket_count = bounds_us.size() + 1;
+
+  struct snapshot {
+    // Cumulative: cumulative[i] samples were at most bounds_us[i], and the
+    // last entry is the total count.
+    std::array<std::uint64_t, bucket_count> cumulative{};
+    std::uint64_t sum_ns = 0;
+
+    std::uint64_t count() const noexcept { return cumulative.back(); }
+  };
+
+  void record(std::chrono::steady_clock::duration elapsed) noexcept {
+    auto ns = std::max<std::int64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count(),
+        0);
+    auto us = static_cast<std::uint64_t>(ns) / 1000;
+    auto bucket = static_cast<std::size_t>(
+        std::lower_bound(bounds_us.begin(), bounds_us.end(), us) -
+        bounds_us.begin());
+    auto &stripe = stripes_[detail::metric_stripe()];
+    stripe.counts[bucket].fetch_add(1, std::memory_order_relaxed);
+    stripe.sum_ns.fetch_add(static_cast<std::uint64_t>(ns),
+                            std::memory_order_relaxed);
+  }
+
+  snapshot read() const noexcept {
+    snapshot result;
+    for (const auto &stripe : stripes_) {
+      for (std::size_t i = 0; i < bucket_count; ++i) {
+        result.cumulative[i] +=
+            stripe.counts[i].load(std::memory_order_relaxed);
+      }
+      result.sum_ns += stripe.sum_ns.load(std::memory_order_relaxed);
+    }
+    for (std::size_t i = 1; i < bucket_count; ++i) {
+      result.cumulative[i] += result.cumulative[i - 1];
+    }
+    return result;
+  }
+
+private:
+  struct alignas(64) stripe {
+    std::array<std::atomic<std::uint64_t>, bucket_count> counts{};
+    std::atomic<std::uint64_t> sum_ns{0};
+  };
+
+  std::array<stripe, detail::metric_stripes> stripes_;
+};
+
+// What the dispatchers of one address family did, over all engine threads.
+struct icmp_metrics {
+  metric_counter probes_sent;
+  // Replies handed to the session whose probe they answer.
+  metric_counter replies_matched;
+  // Packets read that no probe of ours claims, including the ones that do
+  // not decode.
+  metric_counter replies_unmatched;
+  metric_counter checksum_failures;
+  // Probes given up on without a usable reply.
+  metric_counter probe_timeouts;
+  metric_counter sockets_opened;
+  // Replies routed to a session that its coroutine has not taken yet.
+  metric_gauge replies_queued;
+};
+
+// The stages a probe goes through in the module, see module_metrics.
+enum class probe_stage : std::size_t { resolve, send, receive, decode };
+
+inline constexpr std::array<std::string_view, 4> probe_stage_names{
+    "resolve", "send", "receive", "decode"};
+
+// Process-wide counters for the hot paths. Updating one is a relaxed atomic
+// add on a line no other thread writes to, cheap enough to stay always on.
+class module_metrics {
+public:
+  static module_metrics &instance() {
+    static module_metrics metrics;
+    return metrics;
+  }
+
+  template <class IPType> icmp_metrics &icmp() noexcept {
+    return std::is_same_v<IPType, use_ipv4_t> ? icmp_v4 : icmp_v6;
+  }
+
+  latency_histogram &stage(probe_stage stage) noexcept {
+    return stages[static_cast<std::size_t>(stage)];
+  }
+
+  icmp_metrics icmp_v4;
+  icmp_metrics icmp_v6;
+  // resolve: a name lookup that missed the cache. send: one send system
+  // call, of one probe or a batch. receive: draining a readable socket,
+  // decoding included. decode: decoding and routing one packet, timed for
+  // one packet in decode_sample_rate to keep the clock off the hot path.
+  std::array<latency_histogram, probe_stage_names.size()> stages;
+  // Results waiting for their asyncio loop to pick them up.
+  metric_gauge completions_pending;
+
+  static constexpr std::uint64_t decode_sample_rate = 16;
+};
+
+// The metrics in the Prometheus text exposition format, version 0.0.4.
+inline std::string prometheus_text(const module_metrics &metrics) {
+  std::string text;
+  auto out = std::back_inserter(text);
+
+  auto header = [&](std::string_view name, std::string_view type,
+                    std::string_view help) {
+    std::format_to(out, "# HELP networktools_{} {}\n", name, help);
+    std::format_to(out, "# TYPE networktools_{} {}\n", name, type);
+  };
+  auto per_family = [&](std::string_view name, std::string_view type,
+                        std::string_view help, auto value_of) {
+    header(name, type, help);
+    std::format_to(out, "networktools_{}{{family=\"ipv4\"}} {}\n", name,
+                   value_of(metrics.icmp_v4));
+    std::format_to(out, "networktools_{}{{family=\"ipv6\"}} {}\n", name,
+                   value_of(metrics.icmp_v6));
+  };
+
+  per_family("icmp_probes_sent_total", "counter", "ICMP echo requests sent.",
+             [](const icmp_metrics &m) { return m.probes_sent.value(); });
+  per_family("icmp_replies_matched_total", "counter",
+             "ICMP replies routed to the probe they answer.",
+             [](const icmp_metrics &m) { return m.replies_matched.value(); });
+  per_family(
+      "icmp_replies_unmatched_total", "counter",
+      "ICMP packets read that answer none of our probes or do not decode.",
+      [](const icmp_metrics &m) { return m.replies_unmatched.value(); });
+  per_family("icmp_checksum_failures_total", "counter",
+             "ICMP packets dropped for a bad checksum.",
+             [](const icmp_metrics &m) { return m.checksum_failures.value(); });
+  per_family("icmp_probe_timeouts_total", "counter",
+             "ICMP probes given up on without a usable reply.",
+             [](const icmp_metrics &m) { return m.probe_timeouts.value(); });
+  per_family("icmp_sockets_opened_total", "counter", "ICMP sockets opened.",
+             [](const icmp_metrics &m) { return m.sockets_opened.value(); });
+  per_family("icmp_replies_queued", "gauge",
+             "ICMP replies routed but not yet taken by their probe.",
+             [](const icmp_metrics &m) { return m.replies_queued.value(); });
+
+  header("completions_pending", "gauge",
+         "Results waiting for their asyncio loop.");
+  std::format_to(out, "networktools_completions_pending {}\n",
+                 metrics.completions_pending.value());
+
+  header("probe_stage_seconds", "histogram",
+         "Time spent in each stage of a probe.");
+  for (std::size_t i = 0; i < probe_stage_names.size(); ++i) {
+    auto name = probe_stage_names[i];
+    auto snapshot = metrics.stages[i].read();
+    for (std::size_t b = 0; b < latency_histogram::bounds_us.size(); ++b) {
+      std::format_to(out,
+                     "networktools_probe_stage_seconds_bucket{{stage=\"{}\","
+                     "le=\"{}\"}} {}\n",
+                     name, latency_histogram::bounds_us[b] / 1e6,
+                     snapshot.cumulative[b]);
+    }
+    std::format_to(out,
+                   "networktools_probe_stage_seconds_bucket{{stage=\"{}\","
+                   "le=\"+Inf\"}} {}\n",
+                   name, snapshot.count());
+    std::format_to(out,
+                   "networktools_probe_stage_seconds_sum{{stage=\"{}\"}} {}\n",
+                   name, static_cast<double>(snapshot.sum_ns) / 1e9);
+    std::format_to(
+        out, "networktools_probe_stage_seconds_count{{stage=\"{}\"}} {}\n",
+        name, snapshot.count());
+  }
+  return text;
+}
+} // namespace net
+
+#endif // METRICS_HPP
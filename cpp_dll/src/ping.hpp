@@ -3,170 +3,317 @@
 
 #include <asio.hpp>
 #include <asio/experimental/awaitable_operators.hpp>
+#include <algorithm>
 #include <chrono>
 #include <concepts>
+#include <exception>
 #include <iostream>
-#include <istream>
 #include <ostream>
 #include <print>
 #include <string>
 #include <string_view>
+#include <utility>
+#include <variant>
+#include <vector>
 
+#include "dns_cache.hpp"
+#include "icmp_dispatcher.hpp"
 #include "icmp_header.hpp"
+#include "icmp_utils.hpp"
 #include "ipv4_header.hpp"
 #include "ipv6_header.hpp"
+#include "metrics.hpp"
+#include "rtt_stats.hpp"
 
 namespace net {
-struct use_ipv4_t {};
-struct use_ipv6_t {};
+namespace detail {
+// Each of these calls on_probe(index, compose) once per probe, as soon as its
+// reply arrives or it is given up on; a lost probe has a zero length.
 
-inline constexpr use_ipv4_t use_ipv4;
-inline constexpr use_ipv6_t use_ipv6;
+template <class OIPT, class DurationRepType, class DurationPeriodType,
+          class OnProbe>
+asio::awaitable<void>
+ping_each(std::string dest, int count, int ttl,
+          std::chrono::duration<DurationRepType, DurationPeriodType> timeout,
+          OnProbe &on_probe) {
+  auto executor = co_await asio::this_coro::executor;
+  auto addresses =
+      co_await async_resolve_cached(dest, address_family_of<OIPT>());
+  asio::ip::icmp::endpoint destination(addresses.front(), 0);
+  icmp_session<OIPT> session(executor);
+  echo_request_template<OIPT> echo_request(session.identifier(), echo_body);
 
-template <class IPType> struct ip_token_to_header {};
+  for (int sequence_number = 0; sequence_number < count; ++sequence_number) {
+    auto request =
+        echo_request.next(static_cast<unsigned short>(sequence_number));
 
-template <> struct ip_token_to_header<use_ipv4_t> {
-  using type = ipv4_header;
-};
+    std::error_code ec;
+    auto time_sent = co_await session.send_to(request, destination, ttl, ec);
+    auto deadline = time_sent + timeout;
 
-template <> struct ip_token_to_header<use_ipv6_t> {
-  using type = ipv6_header;
-};
-
-template <class IPType>
-using ip_token_to_header_t =
-    typename ip_token_to_header<std::remove_cvref_t<IPType>>::type;
-
-template <class IPType>
-inline constexpr bool is_ip_token_v =
-    std::is_same_v<IPType, use_ipv4_t> || std::is_same_v<IPType, use_ipv6_t>;
-
-template <class HeaderType, class OHT = std::remove_cvref_t<HeaderType>>
-  requires std::is_same_v<OHT, ipv4_header> || std::is_same_v<OHT, ipv6_header>
-struct icmp_compose {
-  OHT ipv4header{};
-  icmp_header icmpheader{};
-  std::size_t length = 0;
-  std::chrono::steady_clock::duration elapsed{};
-};
+    // Replies that arrive late for an earlier probe are skipped; an
+    // unreachable message ends this probe as a failure.
+    icmp_compose<ip_token_to_header_t<OIPT>> compose;
+    while (!ec) {
+      auto reply = co_await session.receive(deadline);
+      if (!reply) {
+        module_metrics::instance().icmp<OIPT>().probe_timeouts.add();
+        break;
+      }
+      if (reply->icmp_hdr.sequence_number() !=
+          static_cast<unsigned short>(sequence_number)) {
+        continue;
+      }
+      if (reply->icmp_hdr.type() !=
+          select_icmp_type<OIPT>(icmp_header::ipv4::destination_unreachable,
+                                 icmp_header::ipv6::destination_unreachable)) {
+        compose = {std::move(reply->ip_hdr), std::move(reply->icmp_hdr),
+                   reply->length, reply->received_at - time_sent};
+      }
+      break;
+    }
+    on_probe(static_cast<std::size_t>(sequence_number), std::move(compose));
+  }
+}
 
-template <class IPType, class DurationRepType, class DurationPeriodType,
-          class OIPT = std::remove_cvref_t<IPType>>
-  requires is_ip_token_v<OIPT>
-inline asio::awaitable<std::vector<icmp_compose<ip_token_to_header_t<OIPT>>>>
-async_ping(
-    std::string_view dest, int count, int ttl,
-    const std::chrono::duration<DurationRepType, DurationPeriodType> &timeout,
-    IPType &&type) {
+template <class OIPT, class TimeoutRep, class TimeoutPeriod,
+          class IntervalRep, class IntervalPeriod, class OnProbe>
+asio::awaitable<void>
+ping_pipelined_each(std::string dest, int count, int ttl,
+                    std::chrono::duration<TimeoutRep, TimeoutPeriod> timeout,
+                    std::chrono::duration<IntervalRep, IntervalPeriod> interval,
+                    OnProbe &on_probe) {
   using namespace asio::experimental::awaitable_operators;
+  using clock = std::chrono::steady_clock;
+  using compose_type = icmp_compose<ip_token_to_header_t<OIPT>>;
 
-  constexpr bool is_v4 = std::is_same_v<OIPT, use_ipv4_t>;
+  struct probe_state {
+    clock::time_point sent_at;
+    bool done = false;
+  };
 
   auto executor = co_await asio::this_coro::executor;
-  asio::ip::icmp::resolver resolver(executor);
+  auto addresses =
+      co_await async_resolve_cached(dest, address_family_of<OIPT>());
+  asio::ip::icmp::endpoint destination(addresses.front(), 0);
+  icmp_session<OIPT> session(executor);
+  echo_request_template<OIPT> echo_request(session.identifier(), echo_body);
 
-  constexpr auto get_icmp = [] -> asio::ip::icmp {
-    if constexpr (is_v4) {
-      return asio::ip::icmp::v4();
-    } else {
-      return asio::ip::icmp::v6();
+  // Probes [oldest, sent) are in flight, in a ring indexed like their 16-bit
+  // sequence numbers, so memory does not grow with the count.
+  const std::size_t total = static_cast<std::size_t>(std::max(count, 0));
+  const std::size_t window = std::clamp<std::size_t>(total, 1, 65536);
+  std::vector<probe_state> ring(window);
+  std::size_t oldest = 0;
+  std::size_t sent = 0;
+
+  auto retire_oldest = [&] {
+    if (!ring[oldest % window].done) {
+      module_metrics::instance().icmp<OIPT>().probe_timeouts.add();
+      on_probe(oldest, compose_type{});
     }
+    ++oldest;
   };
 
-  asio::ip::icmp::endpoint destination =
-      *resolver.resolve(get_icmp(), dest, "").begin();
-  asio::ip::icmp::socket socket(executor, get_icmp());
-  std::string body("\"Hello!\" from Asio ping.");
-  asio::streambuf reply_buffer;
+  auto send_all = [&]() -> asio::awaitable<void> {
+    asio::steady_timer pacer(executor);
+    auto next_send = clock::now();
+    while (sent < total) {
+      // Only when more than 65536 probes are sent within one timeout.
+      if (sent - oldest == window) {
+        retire_oldest();
+      }
+      auto request = echo_request.next(static_cast<unsigned short>(sent));
 
-  if constexpr (is_v4) {
-    if (ttl != 64) {
-      asio::ip::unicast::hops hops(ttl);
-      socket.set_option(hops);
-    }
-  }
+      std::error_code ec;
+      auto sent_at = co_await session.send_to(request, destination, ttl, ec);
+      ring[sent % window] = {sent_at, false};
+      ++sent;
 
-  auto get_identifier = [] -> unsigned short {
-#if defined(ASIO_WINDOWS)
-    return static_cast<unsigned short>(::GetCurrentProcessId());
-#else
-    return static_cast<unsigned short>(::getpid());
-#endif
+      if (sent < total) {
+        next_send += interval;
+        pacer.expires_at(next_send);
+        co_await pacer.async_wait(asio::use_awaitable);
+      }
+    }
   };
 
-  std::vector<icmp_compose<ip_token_to_header_t<OIPT>>> composes;
-  for (int sequence_number = 0; sequence_number < count; ++sequence_number) {
-    // Create an ICMP header for an echo request.
-    icmp_header echo_request;
-    if constexpr (is_v4) {
-      echo_request.type(std::to_underlying(icmp_header::ipv4::echo_request));
-    } else {
-      echo_request.type(std::to_underlying(icmp_header::ipv6::echo_request));
-    }
-    echo_request.code(0);
-    echo_request.identifier(get_identifier());
-    echo_request.sequence_number(sequence_number);
-    compute_checksum(echo_request, body.begin(), body.end());
-
-    // Encode the request packet.
-    asio::streambuf request_buffer;
-    std::ostream os(&request_buffer);
-    os << echo_request << body;
-
-    asio::steady_timer timer(executor);
-
-    timer.expires_after(timeout);
-
-    socket.async_send_to(request_buffer.data(), destination, asio::detached);
-
-    reply_buffer.consume(reply_buffer.size());
-    auto time_sent = std::chrono::steady_clock::now();
-    asio::ip::icmp::endpoint sender;
-    auto value =
-        co_await (socket.async_receive_from(reply_buffer.prepare(65536), sender,
-                                            asio::use_awaitable) ||
-                  timer.async_wait(asio::use_awaitable));
-
-    auto now = std::chrono::steady_clock::now();
-    auto value_ptr = std::get_if<std::size_t>(&value);
-    if (!value_ptr) {
-      composes.emplace_back(ip_token_to_header_t<OIPT>{}, icmp_header{}, 0,
-                            std::chrono::nanoseconds(0));
-      continue;
+  auto receive_all = [&]() -> asio::awaitable<void> {
+    for (;;) {
+      auto now = clock::now();
+      while (oldest < sent) {
+        const auto &probe = ring[oldest % window];
+        if (!probe.done && now - probe.sent_at < timeout) {
+          break;
+        }
+        retire_oldest();
+      }
+      if (oldest == total) {
+        break;
+      }
+
+      clock::time_point wake_at = now + interval;
+      if (oldest < sent) {
+        wake_at = ring[oldest % window].sent_at + timeout;
+      }
+      auto reply = co_await session.receive(wake_at);
+      if (!reply || reply->icmp_hdr.type() ==
+                        select_icmp_type<OIPT>(
+                            icmp_header::ipv4::destination_unreachable,
+                            icmp_header::ipv6::destination_unreachable)) {
+        continue;
+      }
+
+      // Map the sequence number back to the in-flight index it came from.
+      std::size_t index =
+          oldest + static_cast<unsigned short>(
+                       reply->icmp_hdr.sequence_number() -
+                       static_cast<unsigned short>(oldest));
+      if (index >= sent || ring[index % window].done) {
+        continue;
+      }
+      auto &probe = ring[index % window];
+      auto elapsed = reply->received_at - probe.sent_at;
+      if (elapsed > timeout) {
+        continue;
+      }
+      probe.done = true;
+      on_probe(index,
+               compose_type{std::move(reply->ip_hdr),
+                            std::move(reply->icmp_hdr), reply->length,
+                            elapsed});
     }
+  };
+
+  co_await (send_all() && receive_all());
+}
+} // namespace detail
 
-    std::size_t length = *value_ptr;
+template <class IPType, class DurationRepType, class DurationPeriodType,
+          class OIPT = std::remove_cvref_t<IPType>>
+  requires is_ip_token_v<OIPT>
+inline asio::awaitable<std::vector<icmp_compose<ip_token_to_header_t<OIPT>>>>
+async_ping(std::string dest, int count, int ttl,
+           std::chrono::duration<DurationRepType, DurationPeriodType> timeout,
+           IPType &&type) {
+  using compose_type = icmp_compose<ip_token_to_header_t<OIPT>>;
+
+  std::vector<compose_type> composes;
+  composes.reserve(static_cast<std::size_t>(std::max(count, 0)));
+  auto collect = [&](std::size_t, compose_type compose) {
+    composes.push_back(std::move(compose));
+  };
+  co_await detail::ping_each<OIPT>(std::move(dest), count, ttl, timeout,
+                                   collect);
+  co_return composes;
+}
+
+// Sends one echo request every `interval` without waiting for the previous
+// reply and matches replies back to their probe by sequence number, so a run
+// takes about count * interval + timeout instead of count * timeout.
+template <class IPType, class TimeoutRep, class TimeoutPeriod,
+          class IntervalRep, class IntervalPeriod,
+          class OIPT = std::remove_cvref_t<IPType>>
+  requires is_ip_token_v<OIPT>
+inline asio::awaitable<std::vector<icmp_compose<ip_token_to_header_t<OIPT>>>>
+async_ping_pipelined(
+    std::string dest, int count, int ttl,
+    std::chrono::duration<TimeoutRep, TimeoutPeriod> timeout,
+    std::chrono::duration<IntervalRep, IntervalPeriod> interval,
+    IPType &&type) {
+  using compose_type = icmp_compose<ip_token_to_header_t<OIPT>>;
+
+  std::vector<compose_type> composes(
+      static_cast<std::size_t>(std::max(count, 0)));
+  auto collect = [&](std::size_t index, compose_type compose) {
+    composes[index] = std::move(compose);
+  };
+  co_await detail::ping_pipelined_each<OIPT>(std::move(dest), count, ttl,
+                                             timeout, interval, collect);
+  co_return composes;
+}
 
-    reply_buffer.commit(length);
-    std::istream is(&reply_buffer);
-    ip_token_to_header_t<OIPT> ip_hdr;
-    icmp_header icmp_hdr;
-    if constexpr (is_v4) {
-      is >> ip_hdr >> icmp_hdr;
+// Pings like async_ping, or async_ping_pipelined for a positive interval,
+// but only keeps running statistics, so any count runs in constant memory.
+template <class IPType, class TimeoutRep, class TimeoutPeriod,
+          class IntervalRep, class IntervalPeriod,
+          class OIPT = std::remove_cvref_t<IPType>>
+  requires is_ip_token_v<OIPT>
+inline asio::awaitable<rtt_stats>
+async_ping_stats(std::string dest, int count, int ttl,
+                 std::chrono::duration<TimeoutRep, TimeoutPeriod> timeout,
+                 std::chrono::duration<IntervalRep, IntervalPeriod> interval,
+                 IPType &&type) {
+  rtt_stats stats;
+  auto record = [&](std::size_t,
+                    const icmp_compose<ip_token_to_header_t<OIPT>> &compose) {
+    if (compose.length) {
+      stats.record(compose.elapsed);
     } else {
-      is >> icmp_hdr;
-      // populate ipv6 header source address from the sender endpoint
-      ip_hdr.set_source_address(sender.address().to_v6());
+      stats.record_loss();
     }
+  };
+  if (interval.count() > 0) {
+    co_await detail::ping_pipelined_each<OIPT>(std::move(dest), count, ttl,
+                                               timeout, interval, record);
+  } else {
+    co_await detail::ping_each<OIPT>(std::move(dest), count, ttl, timeout,
+                                     record);
+  }
+  co_return stats;
+}
+
+// Both address families of a dual-stack probe. Each family fails on its own,
+// so one unreachable path still leaves the other's results.
+struct ping_dual_result {
+  std::vector<icmp_compose<ipv4_header>> v4;
+  std::exception_ptr v4_error;
+  std::vector<icmp_compose<ipv6_header>> v6;
+  std::exception_ptr v6_error;
+};
 
-    if (is &&
-        (icmp_hdr.type() ==
-             (is_v4 ? std::to_underlying(icmp_header::ipv4::time_exceeded)
-                    : std::to_underlying(icmp_header::ipv6::time_exceeded)) ||
-         icmp_hdr.type() ==
-                 (is_v4 ? std::to_underlying(icmp_header::ipv4::echo_reply)
-                        : std::to_underlying(icmp_header::ipv6::echo_reply)) &&
-             icmp_hdr.identifier() == get_identifier() &&
-             icmp_hdr.sequence_number() == sequence_number)) {
-      auto elapsed = now - time_sent;
-      composes.emplace_back(std::move(ip_hdr), std::move(icmp_hdr), length,
-                            std::move(elapsed));
+namespace detail {
+template <class IPType, class TimeoutRep, class TimeoutPeriod,
+          class IntervalRep, class IntervalPeriod>
+asio::awaitable<void>
+ping_family(std::string dest, int count, int ttl,
+            std::chrono::duration<TimeoutRep, TimeoutPeriod> timeout,
+            std::chrono::duration<IntervalRep, IntervalPeriod> interval,
+            std::vector<icmp_compose<ip_token_to_header_t<IPType>>> &composes,
+            std::exception_ptr &error) {
+  try {
+    if (interval.count() > 0) {
+      composes = co_await async_ping_pipelined(std::move(dest), count, ttl,
+                                               timeout, interval, IPType{});
     } else {
-      composes.push_back({});
+      composes = co_await async_ping(std::move(dest), count, ttl, timeout,
+                                     IPType{});
     }
+  } catch (...) {
+    error = std::current_exception();
   }
+}
+} // namespace detail
 
-  co_return composes;
+// Pings the IPv4 and the IPv6 address of `dest` at the same time, so a
+// dual-stack check takes as long as the slower family instead of the sum.
+// A positive interval selects the pipelined mode for both.
+template <class TimeoutRep, class TimeoutPeriod, class IntervalRep,
+          class IntervalPeriod>
+inline asio::awaitable<ping_dual_result>
+async_ping_dual(std::string dest, int count, int ttl,
+                std::chrono::duration<TimeoutRep, TimeoutPeriod> timeout,
+                std::chrono::duration<IntervalRep, IntervalPeriod> interval) {
+  using namespace asio::experimental::awaitable_operators;
+
+  ping_dual_result result;
+  co_await (detail::ping_family<use_ipv4_t>(dest, count, ttl, timeout,
+                                            interval, result.v4,
+                                            result.v4_error) &&
+            detail::ping_family<use_ipv6_t>(dest, count, ttl, timeout,
+                                            interval, result.v6,
+                                            result.v6_error));
+  co_return result;
 }
 } // namespace net
 
@@ -0,0 +1,267 @@
+#ifndef PING_MANY_HPP
+#define PING_MANY_HPP
+
+#include <asio.hpp>
+#include <asio/experimental/awaitable_operators.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <optional>
+#include <string>
+#include <system_error>
+#include <variant>
+#include <vector>
+
+#include "dns_cache.hpp"
+#include "icmp_dispatcher.hpp"
+#include "icmp_header.hpp"
+#include "icmp_utils.hpp"
+#include "ipv4_header.hpp"
+#include "ipv6_header.hpp"
+#include "join.hpp"
+
+namespace net {
+struct ping_many_result {
+  std::string target;
+  std::string error;
+  std::variant<std::vector<icmp_compose<ipv4_header>>,
+               std::vector<icmp_compose<ipv6_header>>>
+      composes;
+};
+
+namespace detail {
+// Every target of one address family, sharing one dispatcher session.
+// Target i uses the session's i-th identifier, and each round uses its index
+// as the sequence number.
+template <class IPType> class ping_many_lane {
+public:
+  using header_type = ip_token_to_header_t<IPType>;
+  using clock = std::chrono::steady_clock;
+
+  explicit ping_many_lane(const asio::any_io_executor &executor)
+      : executor_(executor) {}
+
+  bool empty() const noexcept { return entries_.empty(); }
+
+  void add(std::size_t result_index,
+           const asio::ip::icmp::endpoint &destination) {
+    entries_.push_back({result_index, destination, {}, {}, {}});
+  }
+
+  void open(int count, int ttl) {
+    session_.emplace(executor_, entries_.size());
+    requests_.reserve(entries_.size());
+    for (std::size_t i = 0; i < entries_.size(); ++i) {
+      requests_.emplace_back(session_->identifier(i), echo_body);
+    }
+    probes_.reserve(entries_.size());
+    send_errors_.resize(entries_.size());
+    ttl_ = ttl;
+    for (auto &entry : entries_) {
+      entry.composes.resize(static_cast<std::size_t>(count));
+      entry.sent_at.resize(static_cast<std::size_t>(count));
+    }
+    pending_ = entries_.size() * static_cast<std::size_t>(count);
+  }
+
+  // Sends the round to every target as one burst. A probe that never left
+  // is lost without being waited for, and its target keeps the first such
+  // error.
+  asio::awaitable<void> send_round(unsigned short sequence_number) {
+    probes_.clear();
+    for (std::size_t i = 0; i < entries_.size(); ++i) {
+      probes_.push_back(
+          {requests_[i].next(sequence_number), entries_[i].destination});
+    }
+
+    std::error_code ec;
+    std::ranges::fill(send_errors_, std::error_code{});
+    auto sent_at =
+        co_await session_->send_batch(probes_, ttl_, ec, send_errors_);
+    for (std::size_t i = 0; i < entries_.size(); ++i) {
+      auto &entry = entries_[i];
+      entry.sent_at[sequence_number] = sent_at;
+      if (send_errors_[i]) {
+        if (!entry.send_error) {
+          entry.send_error = send_errors_[i];
+        }
+        --pending_;
+      }
+    }
+    rounds_sent_ = sequence_number + 1u;
+  }
+
+  template <class Rep, class Period>
+  asio::awaitable<void> receive(clock::time_point deadline,
+                                std::chrono::duration<Rep, Period> timeout) {
+    while (pending_ > 0) {
+      auto reply = co_await session_->receive(deadline);
+      if (!reply) {
+        co_return;
+      }
+      auto &icmp_hdr = reply->icmp_hdr;
+      if (icmp_hdr.type() ==
+          select_icmp_type<IPType>(
+              icmp_header::ipv4::destination_unreachable,
+              icmp_header::ipv6::destination_unreachable)) {
+        continue;
+      }
+
+      std::size_t index = session_->index_of(icmp_hdr.identifier());
+      std::size_t sequence_number = icmp_hdr.sequence_number();
+      if (index >= entries_.size() || sequence_number >= rounds_sent_) {
+        continue;
+      }
+      auto &entry = entries_[index];
+      bool is_echo_reply =
+          icmp_hdr.type() ==
+          select_icmp_type<IPType>(icmp_header::ipv4::echo_reply,
+                                   icmp_header::ipv6::echo_reply);
+      if ((is_echo_reply && asio::ip::address(reply->ip_hdr.source_address()) !=
+                                entry.destination.address()) ||
+          entry.composes[sequence_number].length) {
+        continue;
+      }
+      auto elapsed = reply->received_at - entry.sent_at[sequence_number];
+      if (elapsed > timeout) {
+        continue;
+      }
+      entry.composes[sequence_number] = {std::move(reply->ip_hdr),
+                                         std::move(icmp_hdr), reply->length,
+                                         elapsed};
+      --pending_;
+    }
+  }
+
+  void collect(std::vector<ping_many_result> &results) {
+    for (auto &entry : entries_) {
+      auto &result = results[entry.result_index];
+      result.composes = std::move(entry.composes);
+      if (entry.send_error) {
+        result.error = entry.send_error.message();
+      }
+    }
+  }
+
+private:
+  struct entry {
+    std::size_t result_index;
+    asio::ip::icmp::endpoint destination;
+    std::vector<icmp_compose<header_type>> composes;
+    std::vector<clock::time_point> sent_at;
+    std::error_code send_error;
+  };
+
+  asio::any_io_executor executor_;
+  std::optional<icmp_session<IPType>> session_;
+  std::vector<echo_request_template<IPType>> requests_;
+  std::vector<icmp_probe> probes_;
+  std::vector<std::error_code> send_errors_;
+  std::vector<entry> entries_;
+  int ttl_ = 64;
+  std::size_t rounds_sent_ = 0;
+  std::size_t pending_ = 0;
+};
+} // namespace detail
+
+// Pings every target `count` times through the shared dispatcher, i.e. over
+// one raw socket per address family. Each round is sent to all targets back
+// to back, rounds are `interval` apart, and replies are demultiplexed by
+// (identifier, sequence number), so `count` may be at most 65536.
+template <class TimeoutRep, class TimeoutPeriod, class IntervalRep,
+          class IntervalPeriod>
+inline asio::awaitable<std::vector<ping_many_result>>
+async_ping_many(std::vector<std::string> targets, int count, int ttl,
+                std::chrono::duration<TimeoutRep, TimeoutPeriod> timeout,
+                std::chrono::duration<IntervalRep, IntervalPeriod> interval) {
+  using namespace asio::experimental::awaitable_operators;
+
+  auto executor = co_await asio::this_coro::executor;
+  detail::ping_many_lane<use_ipv4_t> lane_v4(executor);
+  detail::ping_many_lane<use_ipv6_t> lane_v6(executor);
+
+  // Every name is looked up at once, so a batch of cold names costs one
+  // lookup's latency rather than one per target.
+  std::vector<ping_many_result> results(targets.size());
+  std::vector<std::vector<asio::ip::address>> addresses(targets.size());
+  auto resolve = [&](std::size_t i) -> asio::awaitable<void> {
+    try {
+      addresses[i] = co_await async_resolve_cached(results[i].target);
+    } catch (const std::system_error &e) {
+      if (e.code() == asio::error::operation_aborted) {
+        throw;
+      }
+      results[i].error = e.code().message();
+    }
+  };
+  std::vector<asio::awaitable<void>> lookups;
+  lookups.reserve(targets.size());
+  for (std::size_t i = 0; i < targets.size(); ++i) {
+    results[i].target = std::move(targets[i]);
+    lookups.push_back(resolve(i));
+  }
+  co_await join_all(std::move(lookups));
+
+  for (std::size_t i = 0; i < results.size(); ++i) {
+    if (addresses[i].empty()) {
+      continue;
+    }
+    asio::ip::icmp::endpoint destination(addresses[i].front(), 0);
+    if (destination.address().is_v4()) {
+      lane_v4.add(i, destination);
+    } else {
+      results[i].composes.template emplace<1>();
+      lane_v6.add(i, destination);
+    }
+  }
+
+  count = std::max(count, 0);
+  if (!lane_v4.empty()) {
+    lane_v4.open(count, ttl);
+  }
+  if (!lane_v6.empty()) {
+    lane_v6.open(count, ttl);
+  }
+
+  const auto start = std::chrono::steady_clock::now();
+  const auto deadline = start + interval * std::max(count - 1, 0) + timeout;
+
+  auto send_all = [&]() -> asio::awaitable<void> {
+    asio::steady_timer pacer(executor);
+    auto next_send = start;
+    for (int sequence_number = 0; sequence_number < count; ++sequence_number) {
+      auto sequence = static_cast<unsigned short>(sequence_number);
+      if (!lane_v4.empty()) {
+        co_await lane_v4.send_round(sequence);
+      }
+      if (!lane_v6.empty()) {
+        co_await lane_v6.send_round(sequence);
+      }
+      if (sequence_number + 1 < count) {
+        next_send += interval;
+        pacer.expires_at(next_send);
+        co_await pacer.async_wait(asio::use_awaitable);
+      }
+    }
+  };
+
+  auto receive_v4 = [&]() -> asio::awaitable<void> {
+    if (!lane_v4.empty()) {
+      co_await lane_v4.receive(deadline, timeout);
+    }
+  };
+  auto receive_v6 = [&]() -> asio::awaitable<void> {
+    if (!lane_v6.empty()) {
+      co_await lane_v6.receive(deadline, timeout);
+    }
+  };
+
+  co_await (send_all() && receive_v4() && receive_v6());
+
+  lane_v4.collect(results);
+  lane_v6.collect(results);
+  co_return results;
+}
+} // namespace net
+
+#endif // PING_MANY_HPP
@@ -0,0 +1,75 @@
+#ifndef PING_TABLE_HPP
+#define PING_TABLE_HPP
+
+#include <asio.hpp>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "icmp_utils.hpp"
+#include "rtt_stats.hpp"
+
+namespace net {
+enum class probe_status : std::uint8_t {
+  success = 0,
+  timeout = 1,
+};
+
+// The results of one ping run as one array per field rather than one object
+// per probe, so they can be handed to Python without a copy. Row i of every
+// column belongs to probe i; lost probes have an rtt of -1 and zeros
+// elsewhere.
+struct ping_table {
+  // Where the first reply came from; unspecified when nothing answered.
+  asio::ip::address address;
+  std::vector<std::int64_t> rtt_us;
+  std::vector<std::uint16_t> sequence;
+  std::vector<std::uint8_t> ttl;
+  std::vector<std::uint16_t> bytes;
+  std::vector<probe_status> status;
+  rtt_stats stats;
+  // Why the run failed as a whole; empty on success.
+  std::string error;
+};
+
+template <class HeaderType>
+ping_table
+make_ping_table(const std::vector<icmp_compose<HeaderType>> &composes) {
+  ping_table table;
+  const auto rows = composes.size();
+  table.rtt_us.reserve(rows);
+  table.sequence.reserve(rows);
+  table.ttl.reserve(rows);
+  table.bytes.reserve(rows);
+  table.status.reserve(rows);
+
+  for (const auto &[ip_hdr, icmp_hdr, length, elapsed] : composes) {
+    if (!length) {
+      table.rtt_us.push_back(-1);
+      table.sequence.push_back(0);
+      table.ttl.push_back(0);
+      table.bytes.push_back(0);
+      table.status.push_back(probe_status::timeout);
+      table.stats.record_loss();
+      continue;
+    }
+    if (!table.stats.received()) {
+      table.address = ip_hdr.source_address();
+    }
+    table.rtt_us.push_back(
+        std::chrono::duration_cast<std::chrono::microseconds>(elapsed)
+            .count());
+    table.sequence.push_back(icmp_hdr.sequence_number());
+    table.ttl.push_back(static_cast<std::uint8_t>(ip_hdr.time_to_live()));
+    table.bytes.push_back(
+        static_cast<std::uint16_t>(length - ip_hdr.header_length()));
+    table.status.push_back(probe_status::success);
+    table.stats.record(elapsed);
+  }
+  return table;
+}
+} // namespace net
+
+#endif // PING_TABLE_HPP
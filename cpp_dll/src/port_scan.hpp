@@ -0,0 +1,128 @@
+#ifndef PORT_SCAN_HPP
+#define PORT_SCAN_HPP
+
+#include <asio.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+#include "dns_cache.hpp"
+#include "join.hpp"
+#include "tcping.hpp"
+
+namespace net {
+enum class port_state : unsigned char {
+  // Not tried before the scan's deadline.
+  unscanned,
+  open,
+  // Refused: the host answered with a reset.
+  closed,
+  // No answer, or an ICMP unreachable from a filter on the way.
+  filtered,
+  // The connect failed locally, e.g. out of file descriptors.
+  failed,
+};
+
+struct open_port {
+  std::uint16_t port = 0;
+  std::chrono::microseconds connect_time{0};
+};
+
+// One state byte per port of the range, plus the connect times of the open
+// ones.
+struct port_scan_result {
+  asio::ip::address address;
+  std::uint16_t first_port = 0;
+  std::vector<port_state> states;
+  std::vector<open_port> open_ports;
+};
+
+namespace detail {
+inline port_state classify_connect_error(const std::error_code &ec) {
+  if (ec == asio::error::connection_refused) {
+    return port_state::closed;
+  }
+  if (ec == asio::error::timed_out || ec == asio::error::host_unreachable ||
+      ec == asio::error::network_unreachable) {
+    return port_state::filtered;
+  }
+  return port_state::failed;
+}
+} // namespace detail
+
+// Connects to every port in [first_port, last_port] of `host`, keeping at
+// most `max_in_flight` connects outstanding. Each connect gives up after
+// `timeout`; once `deadline` (if positive) has passed no new connect starts
+// and ports that were cut short are reported as unscanned.
+template <class TimeoutRep, class TimeoutPeriod, class DeadlineRep,
+          class DeadlinePeriod>
+inline asio::awaitable<port_scan_result>
+async_port_scan(std::string host, std::uint16_t first_port,
+                std::uint16_t last_port, std::size_t max_in_flight,
+                std::chrono::duration<TimeoutRep, TimeoutPeriod> timeout,
+                std::chrono::duration<DeadlineRep, DeadlinePeriod> deadline) {
+  using clock = std::chrono::steady_clock;
+
+  auto addresses = co_await async_resolve_cached(std::move(host));
+  port_scan_result result;
+  result.address = addresses.front();
+  result.first_port = first_port;
+  if (last_port < first_port) {
+    co_return result;
+  }
+  const std::size_t port_count = last_port - first_port + 1u;
+  result.states.resize(port_count, port_state::unscanned);
+
+  const auto deadline_at = deadline.count() > 0
+                               ? clock::now() + deadline
+                               : clock::time_point::max();
+  std::size_t next = 0;
+
+  // Each worker takes the next port as soon as its connect finishes, so the
+  // budget stays full until the range runs out.
+  auto worker = [&]() -> asio::awaitable<void> {
+    while (next < port_count && clock::now() < deadline_at) {
+      auto index = next++;
+      auto port = static_cast<std::uint16_t>(first_port + index);
+      clock::duration budget = timeout;
+      bool cut_short = false;
+      if (deadline_at - clock::now() < budget) {
+        budget = deadline_at - clock::now();
+        cut_short = true;
+      }
+      auto elapsed = co_await detail::tcp_connect_time(
+          asio::ip::tcp::endpoint(result.address, port), budget);
+      if (elapsed) {
+        result.states[index] = port_state::open;
+        result.open_ports.push_back(
+            {port,
+             std::chrono::duration_cast<std::chrono::microseconds>(*elapsed)});
+      } else if (!cut_short || elapsed.error() != asio::error::timed_out) {
+        result.states[index] = detail::classify_connect_error(elapsed.error());
+      }
+    }
+  };
+
+  // The workers borrow this frame, so it is left only once all of them have
+  // finished, cancelled or not.
+  std::vector<asio::awaitable<void>> workers;
+  for (auto i = std::clamp<std::size_t>(max_in_flight, 1, port_count); i > 0;
+       --i) {
+    workers.push_back(worker());
+  }
+  co_await join_all(std::move(workers));
+
+  std::sort(result.open_ports.begin(), result.open_ports.end(),
+            [](const open_port &a, const open_port &b) {
+              return a.port < b.port;
+            });
+  co_return result;
+}
+} // namespace net
+
+#endif // PORT_SCAN_HPP
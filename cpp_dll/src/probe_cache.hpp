@@ -0,0 +1,289 @@
+#ifndef PROBE_CACHE_HPP
+#define PROBE_CACHE_HPP
+
+#include <asio.hpp>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace net {
+struct probe_cache_stats {
+  // Answered from a fresh cached result.
+  std::uint64_t hits = 0;
+  // Attached to an identical probe already in flight.
+  std::uint64_t joins = 0;
+  // Ran a probe of their own.
+  std::uint64_t misses = 0;
+};
+
+// Settings and counters shared by the caches of every result type.
+class probe_cache_config {
+public:
+  static constexpr std::chrono::milliseconds default_freshness{5000};
+  static constexpr std::size_t default_capacity = 64;
+
+  static probe_cache_config &instance() {
+    static probe_cache_config config;
+    return config;
+  }
+
+  // A freshness or capacity of zero still merges concurrent probes but
+  // caches nothing.
+  void configure(std::chrono::milliseconds freshness, std::size_t capacity) {
+    freshness_ms_.store(freshness.count(), std::memory_order_relaxed);
+    capacity_.store(capacity, std::memory_order_relaxed);
+  }
+
+  std::chrono::milliseconds freshness() const noexcept {
+    return std::chrono::milliseconds(
+        freshness_ms_.load(std::memory_order_relaxed));
+  }
+
+  std::size_t capacity() const noexcept {
+    return capacity_.load(std::memory_order_relaxed);
+  }
+
+  // Results cached before the last clear() are ignored from then on.
+  void clear() noexcept {
+    generation_.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  std::uint64_t generation() const noexcept {
+    return generation_.load(std::memory_order_relaxed);
+  }
+
+  probe_cache_stats stats() const noexcept {
+    return {hits_.load(std::memory_order_relaxed),
+            joins_.load(std::memory_order_relaxed),
+            misses_.load(std::memory_order_relaxed)};
+  }
+
+  void count_hit() noexcept { hits_.fetch_add(1, std::memory_order_relaxed); }
+  void count_join() noexcept {
+    joins_.fetch_add(1, std::memory_order_relaxed);
+  }
+  void count_miss() noexcept {
+    misses_.fetch_add(1, std::memory_order_relaxed);
+  }
+
+private:
+  std::atomic<std::chrono::milliseconds::rep> freshness_ms_{
+      default_freshness.count()};
+  std::atomic<std::size_t> capacity_{default_capacity};
+  std::atomic<std::uint64_t> generation_{0};
+  std::atomic<std::uint64_t> hits_{0};
+  std::atomic<std::uint64_t> joins_{0};
+  std::atomic<std::uint64_t> misses_{0};
+};
+
+// Runs identical probes once. Callers asking for a key whose probe is in
+// flight wait for that run instead of starting their own, and results stay
+// in a bounded LRU list for the configured freshness window. Failures reach
+// every caller that was waiting but are never cached.
+template <class T> class probe_cache {
+public:
+  using clock = std::chrono::steady_clock;
+
+  static probe_cache &instance() {
+    static probe_cache cache;
+    return cache;
+  }
+
+  // `make()` returns the asio::awaitable<T> that runs the probe for `key`.
+  // A caller that is cancelled stops waiting right away; the probe itself is
+  // only cancelled once nobody waits for it any more.
+  template <class Factory>
+  asio::awaitable<T> run(std::string key, Factory make) {
+    auto &config = probe_cache_config::instance();
+    if (auto cached = find(key, config)) {
+      config.count_hit();
+      co_return std::move(*cached);
+    }
+
+    auto executor = co_await asio::this_coro::executor;
+    co_return co_await asio::async_initiate<
+        decltype(asio::use_awaitable), void(std::exception_ptr, T)>(
+        [&](auto handler) {
+          std::lock_guard lock(mutex_);
+          auto &flight = flights_[key];
+          bool started = !flight;
+          if (started) {
+            flight = std::make_shared<flight_state>(executor);
+          }
+          auto id = next_waiter_id_++;
+          auto slot = asio::get_associated_cancellation_slot(handler);
+          if (slot.is_connected()) {
+            slot.assign([this, flight = flight, id](asio::cancellation_type) {
+              abandon(flight, id);
+            });
+          }
+          flight->waiters.emplace_back(id, make_waiter(std::move(handler)));
+          if (!started) {
+            config.count_join();
+            return;
+          }
+          config.count_miss();
+          // The probe runs on its own, so it still completes for the others
+          // if the caller that started it goes away.
+          asio::co_spawn(
+              executor, make(),
+              asio::bind_cancellation_slot(
+                  flight->cancel.slot(),
+                  [this, key, flight = flight](std::exception_ptr error,
+                                               T value) {
+                    finish(key, flight, error, std::move(value));
+                  }));
+        },
+        asio::use_awaitable);
+  }
+
+private:
+  using waiter = std::move_only_function<void(std::exception_ptr, T)>;
+
+  struct flight_state {
+    explicit flight_state(const asio::any_io_executor &executor)
+        : executor(executor) {}
+
+    asio::any_io_executor executor;
+    asio::cancellation_signal cancel;
+    std::vector<std::pair<std::uint64_t, waiter>> waiters;
+  };
+
+  struct entry {
+    std::string key;
+    T value;
+    clock::time_point stored_at;
+    std::uint64_t generation;
+  };
+
+  // Resumes the waiting coroutine on its own executor, never inside finish.
+  template <class Handler> static waiter make_waiter(Handler handler) {
+    return [handler = std::move(handler)](std::exception_ptr error,
+                                          T value) mutable {
+      auto executor = asio::get_associated_executor(handler);
+      asio::post(executor, [handler = std::move(handler), error,
+                            value = std::move(value)]() mutable {
+        asio::get_associated_cancellation_slot(handler).clear();
+        std::move(handler)(error, std::move(value));
+      });
+    };
+  }
+
+  // Called from a waiter's cancellation slot.
+  void abandon(const std::shared_ptr<flight_state> &flight, std::uint64_t id) {
+    waiter abandoned;
+    bool last = false;
+    {
+      std::lock_guard lock(mutex_);
+      auto &waiters = flight->waiters;
+      auto it = std::find_if(waiters.begin(), waiters.end(),
+                             [id](const auto &w) { return w.first == id; });
+      if (it == waiters.end()) {
+        // Already being completed by finish.
+        return;
+      }
+      abandoned = std::move(it->second);
+      waiters.erase(it);
+      last = waiters.empty();
+      if (last) {
+        // Later callers start afresh instead of joining a cancelled run.
+        for (auto f = flights_.begin(); f != flights_.end(); ++f) {
+          if (f->second == flight) {
+            flights_.erase(f);
+            break;
+          }
+        }
+      }
+    }
+    abandoned(std::make_exception_ptr(
+                  asio::system_error(asio::error::operation_aborted)),
+              T{});
+    if (last) {
+      asio::post(flight->executor, [flight] {
+        flight->cancel.emit(asio::cancellation_type::terminal);
+      });
+    }
+  }
+
+  std::optional<T> find(const std::string &key,
+                        const probe_cache_config &config) {
+    std::lock_guard lock(mutex_);
+    auto it = index_.find(key);
+    if (it == index_.end()) {
+      return std::nullopt;
+    }
+    auto &cached = *it->second;
+    if (cached.generation != config.generation() ||
+        clock::now() - cached.stored_at >= config.freshness()) {
+      entries_.erase(it->second);
+      index_.erase(it);
+      return std::nullopt;
+    }
+    entries_.splice(entries_.begin(), entries_, it->second);
+    return cached.value;
+  }
+
+  void finish(const std::string &key,
+              const std::shared_ptr<flight_state> &flight,
+              std::exception_ptr error, T value) {
+    auto &config = probe_cache_config::instance();
+    std::vector<std::pair<std::uint64_t, waiter>> waiters;
+    {
+      std::lock_guard lock(mutex_);
+      if (auto it = flights_.find(key);
+          it != flights_.end() && it->second == flight) {
+        flights_.erase(it);
+      }
+      waiters = std::move(flight->waiters);
+      if (!error) {
+        store(key, value, config);
+      }
+    }
+    for (std::size_t i = 0; i + 1 < waiters.size(); ++i) {
+      waiters[i].second(error, value);
+    }
+    if (!waiters.empty()) {
+      waiters.back().second(error, std::move(value));
+    }
+  }
+
+  void store(const std::string &key, const T &value,
+             const probe_cache_config &config) {
+    auto capacity = config.capacity();
+    if (capacity == 0 || config.freshness().count() <= 0) {
+      return;
+    }
+    if (auto it = index_.find(key); it != index_.end()) {
+      entries_.erase(it->second);
+      index_.erase(it);
+    }
+    entries_.push_front({key, value, clock::now(), config.generation()});
+    index_[key] = entries_.begin();
+    while (entries_.size() > capacity) {
+      index_.erase(entries_.back().key);
+      entries_.pop_back();
+    }
+  }
+
+  std::mutex mutex_;
+  // Most recently used first.
+  std::list<entry> entries_;
+  std::unordered_map<std::string, typename std::list<entry>::iterator> index_;
+  std::unordered_map<std::string, std::shared_ptr<flight_state>> flights_;
+  std::uint64_t next_waiter_id_ = 0;
+};
+} // namespace net
+
+#endif // PROBE_CACHE_HPP
@@ -0,0 +1,148 @@
+#ifndef RTT_STATS_HPP
+#define RTT_STATS_HPP
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+
+namespace net {
+// Counts of round trip times in microseconds, in buckets whose width grows
+// with the value as in HdrHistogram: exact below 128 us, then 64 buckets per
+// power of two, so a reported percentile is within 1/64 of the true sample.
+// The memory is fixed however many samples are recorded; times beyond
+// max_value (about 71 minutes) land in the last bucket.
+class rtt_histogram {
+public:
+  static constexpr unsigned sub_bucket_bits = 6;
+  static constexpr std::uint64_t sub_bucket_count = 1u << sub_bucket_bits;
+  static constexpr std::uint64_t max_value = 0xFFFFFFFF;
+  // The exact range, then one row of sub-buckets per shift of 1 to 25.
+  static constexpr std::size_t bucket_count =
+      2 * sub_bucket_count + (32 - sub_bucket_bits - 1) * sub_bucket_count;
+
+  void record(std::uint64_t value) noexcept { ++counts_[index_of(value)]; }
+
+  // The value below which a fraction `p` of the samples fall, `p` in
+  // [0, 1], out of `total` recorded samples.
+  std::uint64_t percentile(double p, std::uint64_t total) const noexcept {
+    if (!total) {
+      return 0;
+    }
+    auto rank = static_cast<std::uint64_t>(
+        std::ceil(p * static_cast<double>(total)));
+    rank = std::clamp<std::uint64_t>(rank, 1, total);
+    std::uint64_t seen = 0;
+    for (std::size_t i = 0; i < bucket_count; ++i) {
+      seen += counts_[i];
+      if (seen >= rank) {
+        return value_of(i);
+      }
+    }
+    return max_value;
+  }
+
+private:
+  static std::size_t index_of(std::uint64_t value) noexcept {
+    value = std::min(value, max_value);
+    if (value < 2 * sub_bucket_count) {
+      return static_cast<std::size_t>(value);
+    }
+    // Keep the top sub_bucket_bits + 1 bits; the shift picks the octave.
+    auto shift =
+        static_cast<unsigned>(std::bit_width(value)) - sub_bucket_bits - 1;
+    return static_cast<std::size_t>(2 * sub_bucket_count +
+                                    (shift - 1) * sub_bucket_count +
+                                    (value >> shift) - sub_bucket_count);
+  }
+
+  // The middle of bucket `index`.
+  static std::uint64_t value_of(std::size_t index) noexcept {
+    if (index < 2 * sub_bucket_count) {
+      return index;
+    }
+    auto offset = index - 2 * sub_bucket_count;
+    auto shift = static_cast<unsigned>(offset / sub_bucket_count) + 1;
+    auto lowest = (offset % sub_bucket_count + sub_bucket_count) << shift;
+    return lowest + (std::uint64_t{1} << shift) / 2;
+  }
+
+  std::array<std::uint64_t, bucket_count> counts_{};
+};
+
+// Summary statistics of a probe run, updated one probe at a time in constant
+// memory: Welford's running mean and variance, the histogram above for
+// percentiles, and the RFC 3550 jitter estimate over consecutive replies.
+class rtt_stats {
+public:
+  using duration = std::chrono::microseconds;
+
+  void record(std::chrono::steady_clock::duration rtt) noexcept {
+    auto us = std::max<duration::rep>(
+        std::chrono::duration_cast<duration>(rtt).count(), 0);
+    auto value = static_cast<double>(us);
+    if (!received_) {
+      min_ = max_ = us;
+    } else {
+      min_ = std::min(min_, us);
+      max_ = std::max(max_, us);
+      jitter_ += (std::abs(value - last_) - jitter_) / 16;
+    }
+    ++received_;
+    auto delta = value - mean_;
+    mean_ += delta / static_cast<double>(received_);
+    m2_ += delta * (value - mean_);
+    last_ = value;
+    histogram_.record(static_cast<std::uint64_t>(us));
+  }
+
+  void record_loss() noexcept { ++lost_; }
+
+  std::uint64_t transmitted() const noexcept { return received_ + lost_; }
+  std::uint64_t received() const noexcept { return received_; }
+  std::uint64_t lost() const noexcept { return lost_; }
+
+  // Fraction of probes without a reply, in [0, 1].
+  double loss_rate() const noexcept {
+    return transmitted() ? static_cast<double>(lost_) /
+                               static_cast<double>(transmitted())
+                         : 0;
+  }
+
+  duration min() const noexcept { return duration(min_); }
+  duration max() const noexcept { return duration(max_); }
+  // In microseconds, like the rest.
+  double mean() const noexcept { return mean_; }
+  double variance() const noexcept {
+    return received_ ? m2_ / static_cast<double>(received_) : 0;
+  }
+  double stddev() const noexcept { return std::sqrt(variance()); }
+  double jitter() const noexcept { return jitter_; }
+
+  // Within 1/64 of the true percentile, and never outside [min, max].
+  duration percentile(double p) const noexcept {
+    if (!received_) {
+      return {};
+    }
+    auto value = static_cast<duration::rep>(
+        histogram_.percentile(p, received_));
+    return duration(std::clamp(value, min_, max_));
+  }
+
+private:
+  std::uint64_t received_ = 0;
+  std::uint64_t lost_ = 0;
+  duration::rep min_ = 0;
+  duration::rep max_ = 0;
+  double mean_ = 0;
+  double m2_ = 0;
+  double last_ = 0;
+  double jitter_ = 0;
+  rtt_histogram histogram_;
+};
+} // namespace net
+
+#endif // RTT_STATS_HPP
@@ -0,0 +1,275 @@
+#ifndef SWEEP_HPP
+#define SWEEP_HPP
+
+#include <asio.hpp>
+#include <asio/experimental/awaitable_operators.hpp>
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <vector>
+
+#include "icmp_dispatcher.hpp"
+#include "icmp_header.hpp"
+#include "icmp_utils.hpp"
+#include "metrics.hpp"
+
+namespace net {
+// An address prefix, enumerated on demand instead of expanded up front.
+class cidr_range {
+public:
+  // Host bits beyond this would take days to sweep at any sane rate.
+  static constexpr unsigned max_host_bits = 32;
+
+  // Parses "address/prefix"; a bare address is a range of one.
+  static cidr_range parse(std::string_view text) {
+    auto slash = text.find('/');
+    std::error_code ec;
+    auto address = asio::ip::make_address(
+        std::string(text.substr(0, slash)), ec);
+    if (ec) {
+      throw std::invalid_argument("invalid address in " + std::string(text));
+    }
+    unsigned bits = address.is_v4() ? 32 : 128;
+    unsigned prefix = bits;
+    if (slash != std::string_view::npos) {
+      auto digits = text.substr(slash + 1);
+      auto [end, error] = std::from_chars(
+          digits.data(), digits.data() + digits.size(), prefix);
+      if (error != std::errc() || end != digits.data() + digits.size() ||
+          prefix > bits) {
+        throw std::invalid_argument("invalid prefix in " + std::string(text));
+      }
+    }
+    if (bits - prefix > max_host_bits) {
+      throw std::invalid_argument("prefix too short to sweep: " +
+                                  std::string(text));
+    }
+    return cidr_range(address, bits - prefix);
+  }
+
+  bool is_v4() const noexcept { return network_.is_v4(); }
+
+  std::uint64_t size() const noexcept { return std::uint64_t{1} << host_bits_; }
+
+  // The index-th address of the range; index < size().
+  asio::ip::address at(std::uint64_t index) const {
+    auto offset = static_cast<std::uint32_t>(index);
+    if (network_.is_v4()) {
+      return asio::ip::address_v4(network_.to_v4().to_uint() + offset);
+    }
+    // The host bits are at most the last 32, and they are zero in the
+    // network address, so adding the offset never carries.
+    auto bytes = network_.to_v6().to_bytes();
+    for (std::size_t i = 0; i < 4; ++i) {
+      bytes[15 - i] |= static_cast<unsigned char>(offset >> (8 * i));
+    }
+    return asio::ip::address_v6(bytes);
+  }
+
+private:
+  cidr_range(const asio::ip::address &address, unsigned host_bits)
+      : host_bits_(host_bits) {
+    auto mask = host_bits == 32 ? ~std::uint32_t{0}
+                                : (std::uint32_t{1} << host_bits) - 1;
+    if (address.is_v4()) {
+      network_ = asio::ip::address_v4(address.to_v4().to_uint() & ~mask);
+    } else {
+      auto bytes = address.to_v6().to_bytes();
+      for (std::size_t i = 0; i < 4; ++i) {
+        bytes[15 - i] &= static_cast<unsigned char>(~(mask >> (8 * i)));
+      }
+      network_ = asio::ip::address_v6(bytes);
+    }
+  }
+
+  asio::ip::address network_;
+  unsigned host_bits_ = 0;
+};
+
+// Paces sends to `rate` per second on average while allowing bursts of up to
+// `burst` back to back. A rate of zero or less means no limit.
+class token_bucket {
+public:
+  using clock = std::chrono::steady_clock;
+
+  token_bucket(double rate, double burst)
+      : rate_(rate), burst_(std::max(burst, 1.0)), tokens_(burst_),
+        last_(clock::now()) {}
+
+  asio::awaitable<void> acquire(asio::steady_timer &timer) {
+    if (rate_ <= 0) {
+      co_return;
+    }
+    refill();
+    while (tokens_ < 1) {
+      timer.expires_after(std::chrono::duration_cast<clock::duration>(
+          std::chrono::duration<double>((1 - tokens_) / rate_)));
+      co_await timer.async_wait(asio::use_awaitable);
+      refill();
+    }
+    tokens_ -= 1;
+  }
+
+private:
+  void refill() {
+    auto now = clock::now();
+    std::chrono::duration<double> elapsed = now - last_;
+    tokens_ = std::min(burst_, tokens_ + elapsed.count() * rate_);
+    last_ = now;
+  }
+
+  double rate_;
+  double burst_;
+  double tokens_;
+  clock::time_point last_;
+};
+
+struct sweep_summary {
+  std::uint64_t addresses = 0;
+  std::uint64_t sent = 0;
+  std::uint64_t received = 0;
+};
+
+namespace detail {
+template <class IPType, class Rep, class Period, class Handler>
+asio::awaitable<sweep_summary>
+sweep_family(const cidr_range &range, token_bucket bucket, std::size_t window,
+             std::chrono::duration<Rep, Period> timeout, Handler &on_reply) {
+  using namespace asio::experimental::awaitable_operators;
+  using clock = std::chrono::steady_clock;
+
+  struct probe_state {
+    clock::time_point sent_at;
+    bool done = false;
+  };
+
+  auto executor = co_await asio::this_coro::executor;
+  icmp_session<IPType> session(executor);
+  echo_request_template<IPType> echo_request(session.identifier(), echo_body);
+
+  // Probes [oldest, next) are in flight, in a ring of `window` slots. Their
+  // sequence number is the index's low 16 bits, so a window of at most 65536
+  // keeps them unique.
+  window = std::clamp<std::size_t>(window, 1, 65536);
+  std::vector<probe_state> ring(window);
+  std::uint64_t oldest = 0;
+  std::uint64_t next = 0;
+  bool sender_done = false;
+  asio::steady_timer room(executor);
+  sweep_summary summary{range.size(), 0, 0};
+
+  auto send_all = [&]() -> asio::awaitable<void> {
+    asio::steady_timer pacer(executor);
+    for (; next < range.size(); ++next) {
+      while (next - oldest >= window) {
+        room.expires_at(clock::time_point::max());
+        std::error_code ec;
+        co_await room.async_wait(asio::redirect_error(asio::use_awaitable, ec));
+      }
+      co_await bucket.acquire(pacer);
+
+      auto request = echo_request.next(static_cast<unsigned short>(next));
+      std::error_code ec;
+      auto sent_at = co_await session.send_to(
+          request, asio::ip::icmp::endpoint(range.at(next), 0), 64, ec);
+      // A probe that never left is neither awaited nor a timeout; the
+      // receiver frees its slot right away.
+      ring[next % window] = {sent_at, static_cast<bool>(ec)};
+      if (ec) {
+        session.wake();
+      } else {
+        ++summary.sent;
+      }
+    }
+    sender_done = true;
+    session.wake();
+  };
+
+  auto receive_all = [&]() -> asio::awaitable<void> {
+    for (;;) {
+      auto now = clock::now();
+      auto before = oldest;
+      while (oldest < next) {
+        const auto &probe = ring[oldest % window];
+        if (!probe.done && now - probe.sent_at < timeout) {
+          break;
+        }
+        if (!probe.done) {
+          module_metrics::instance().icmp<IPType>().probe_timeouts.add();
+        }
+        ++oldest;
+      }
+      if (oldest != before) {
+        room.cancel();
+      }
+      if (sender_done && oldest == next) {
+        break;
+      }
+
+      auto wake_at = oldest < next ? ring[oldest % window].sent_at + timeout
+                                   : now + timeout;
+      auto reply = co_await session.receive(wake_at);
+      if (!reply) {
+        continue;
+      }
+      // Map the sequence number back to the in-flight index it came from.
+      std::uint64_t index =
+          oldest + static_cast<unsigned short>(
+                       reply->icmp_hdr.sequence_number() -
+                       static_cast<unsigned short>(oldest));
+      if (index >= next || ring[index % window].done) {
+        continue;
+      }
+      auto &probe = ring[index % window];
+      if (reply->icmp_hdr.type() !=
+          select_icmp_type<IPType>(icmp_header::ipv4::echo_reply,
+                                   icmp_header::ipv6::echo_reply)) {
+        // An error quoting the probe: nothing will answer it.
+        probe.done = true;
+        continue;
+      }
+      auto address = range.at(index);
+      auto elapsed = reply->received_at - probe.sent_at;
+      if (asio::ip::address(reply->ip_hdr.source_address()) != address ||
+          elapsed > timeout) {
+        continue;
+      }
+      probe.done = true;
+      ++summary.received;
+      on_reply(address,
+               std::chrono::duration_cast<std::chrono::microseconds>(elapsed));
+    }
+  };
+
+  co_await (send_all() && receive_all());
+  co_return summary;
+}
+} // namespace detail
+
+// Pings every address of `cidr` once. Sends are paced by a token bucket of
+// `rate` packets per second and `burst` packets, and at most `window` probes
+// are awaiting a reply or their timeout at any time, so memory stays
+// constant however large the range. `on_reply(address, rtt)` is called as
+// each reply arrives.
+template <class Rep, class Period, class Handler>
+inline asio::awaitable<sweep_summary>
+async_sweep(std::string cidr, double rate, double burst, std::size_t window,
+            std::chrono::duration<Rep, Period> timeout, Handler on_reply) {
+  auto range = cidr_range::parse(cidr);
+  token_bucket bucket(rate, burst);
+  if (range.is_v4()) {
+    co_return co_await detail::sweep_family<use_ipv4_t>(range, bucket, window,
+                                                       timeout, on_reply);
+  }
+  co_return co_await detail::sweep_family<use_ipv6_t>(range, bucket, window,
+                                                     timeout, on_reply);
+}
+} // namespace net
+
+#endif // SWEEP_HPP
@@ -3,40 +3,219 @@
 
 #include <asio.hpp>
 #include <asio/experimental/awaitable_operators.hpp>
+#include <algorithm>
 #include <chrono>
+#include <cstddef>
 #include <cstdint>
 #include <expected>
 #include <string>
 #include <system_error>
 #include <type_traits>
+#include <utility>
+#include <vector>
 
-namespace net {
+#include "dns_cache.hpp"
+#include "join.hpp"
+#include "rtt_stats.hpp"
 
-asio::awaitable<std::chrono::milliseconds>
-async_tcping(std::string_view host, std::uint16_t port,
-             const std::chrono::steady_clock::duration &timeout) {
+namespace net {
+namespace detail {
+// Connects once and returns how long the handshake took. A refused
+// connection fails right away; no answer at all fails with timed_out.
+template <class Rep, class Period>
+asio::awaitable<
+    std::expected<std::chrono::steady_clock::duration, std::error_code>>
+tcp_connect_time(asio::ip::tcp::endpoint endpoint,
+                 std::chrono::duration<Rep, Period> timeout) {
   using namespace asio::experimental::awaitable_operators;
 
   auto executor = co_await asio::this_coro::executor;
-  asio::ip::tcp::resolver resolver(executor);
   asio::ip::tcp::socket socket(executor);
-
-  auto port_str = std::to_string(port);
-  auto endpoint = *resolver.resolve(host, port_str).begin();
   asio::steady_timer timer(executor);
   timer.expires_after(timeout);
+  std::error_code ec;
   auto start = std::chrono::steady_clock::now();
-  auto res = co_await (socket.async_connect(endpoint, asio::use_awaitable) ||
-                       timer.async_wait(asio::use_awaitable));
+  auto res = co_await (
+      socket.async_connect(endpoint,
+                           asio::redirect_error(asio::use_awaitable, ec)) ||
+      timer.async_wait(asio::use_awaitable));
   auto end = std::chrono::steady_clock::now();
   if (res.index()) {
-    throw std::system_error(std::make_error_code(std::errc::timed_out));
+    co_return std::unexpected(std::error_code(asio::error::timed_out));
+  }
+  if (ec) {
+    co_return std::unexpected(ec);
   }
-  std::error_code ec;
   socket.close(ec);
-  co_return std::chrono::duration_cast<std::chrono::milliseconds>(end - start);
+  co_return end - start;
 }
+} // namespace detail
 
+asio::awaitable<std::chrono::milliseconds>
+async_tcping(std::string host, std::uint16_t port,
+             std::chrono::steady_clock::duration timeout) {
+  auto addresses = co_await async_resolve_cached(std::move(host));
+  auto elapsed = co_await detail::tcp_connect_time(
+      asio::ip::tcp::endpoint(addresses.front(), port), timeout);
+  if (!elapsed) {
+    throw std::system_error(elapsed.error());
+  }
+  co_return std::chrono::duration_cast<std::chrono::milliseconds>(*elapsed);
+}
+
+// Connect times to one resolved address. Failed attempts count as losses.
+struct tcping_endpoint_stats {
+  asio::ip::tcp::endpoint endpoint;
+  std::size_t attempts = 0;
+  // Rounds in which this address connected first.
+  std::size_t wins = 0;
+  rtt_stats rtt;
+  std::error_code last_error;
+};
+
+namespace detail {
+// The attempts of one round. Each waits at its gate until the pacer
+// launches it or the round closes without it.
+struct tcping_race {
+  tcping_race(const asio::any_io_executor &executor, std::size_t attempts)
+      : pacer(executor) {
+    gates.reserve(attempts);
+    for (std::size_t i = 0; i < attempts; ++i) {
+      gates.emplace_back(executor, asio::steady_timer::time_point::max());
+    }
+  }
+
+  std::size_t launched = 0;
+  std::size_t failures = 0;
+  bool won = false;
+  bool closed = false;
+  asio::steady_timer pacer;
+  std::vector<asio::steady_timer> gates;
+};
+
+template <class Rep, class Period>
+asio::awaitable<void>
+tcping_attempt(std::size_t index, std::chrono::duration<Rep, Period> timeout,
+               tcping_endpoint_stats &stats, tcping_race &race) {
+  while (index >= race.launched && !race.closed) {
+    std::error_code ec;
+    co_await race.gates[index].async_wait(
+        asio::redirect_error(asio::use_awaitable, ec));
+  }
+  if (index >= race.launched) {
+    co_return;
+  }
+  auto elapsed = co_await tcp_connect_time(stats.endpoint, timeout);
+  ++stats.attempts;
+  if (elapsed) {
+    stats.rtt.record(*elapsed);
+    if (!race.won) {
+      race.won = true;
+      ++stats.wins;
+    }
+  } else {
+    stats.rtt.record_loss();
+    stats.last_error = elapsed.error();
+    ++race.failures;
+  }
+  race.pacer.cancel();
+}
+
+// Launches the attempts of `race` in order, each `attempt_delay` after the
+// previous one or as soon as one fails, until one has connected.
+template <class Rep, class Period>
+asio::awaitable<void>
+tcping_pace(std::chrono::duration<Rep, Period> attempt_delay,
+            tcping_race &race) {
+  using clock = std::chrono::steady_clock;
+
+  for (std::size_t i = 0; i < race.gates.size() && !race.won; ++i) {
+    ++race.launched;
+    race.gates[i].cancel();
+    if (attempt_delay.count() <= 0 || i + 1 == race.gates.size()) {
+      continue;
+    }
+    auto failures = race.failures;
+    auto next_attempt = clock::now() + attempt_delay;
+    while (!race.won && race.failures == failures &&
+           clock::now() < next_attempt) {
+      race.pacer.expires_at(next_attempt);
+      std::error_code ec;
+      co_await race.pacer.async_wait(
+          asio::redirect_error(asio::use_awaitable, ec));
+    }
+  }
+  race.closed = true;
+  for (auto &gate : race.gates) {
+    gate.cancel();
+  }
+}
+
+// Orders addresses as RFC 8305 does: alternating families, starting with the
+// family the resolver listed first.
+inline std::vector<asio::ip::address>
+interleave_families(const std::vector<asio::ip::address> &addresses) {
+  std::vector<asio::ip::address> first;
+  std::vector<asio::ip::address> second;
+  for (const auto &address : addresses) {
+    (address.is_v4() == addresses.front().is_v4() ? first : second)
+        .push_back(address);
+  }
+  std::vector<asio::ip::address> ordered;
+  ordered.reserve(addresses.size());
+  for (std::size_t i = 0; i < std::max(first.size(), second.size()); ++i) {
+    if (i < first.size()) {
+      ordered.push_back(first[i]);
+    }
+    if (i < second.size()) {
+      ordered.push_back(second[i]);
+    }
+  }
+  return ordered;
+}
+} // namespace detail
+
+// Runs `count` rounds, `interval` apart, against every address of `host`.
+// Each round races the addresses Happy Eyeballs style: attempts start in
+// RFC 8305 order, each `attempt_delay` after the previous one or as soon as
+// it fails, and none start once one has connected. Attempts already started
+// run to completion, so with no delay every address is measured each round.
+template <class TimeoutRep, class TimeoutPeriod, class IntervalRep,
+          class IntervalPeriod, class DelayRep, class DelayPeriod>
+inline asio::awaitable<std::vector<tcping_endpoint_stats>>
+async_tcping_stats(std::string host, std::uint16_t port, int count,
+                   std::chrono::duration<TimeoutRep, TimeoutPeriod> timeout,
+                   std::chrono::duration<IntervalRep, IntervalPeriod> interval,
+                   std::chrono::duration<DelayRep, DelayPeriod> attempt_delay) {
+  using clock = std::chrono::steady_clock;
+
+  auto executor = co_await asio::this_coro::executor;
+  auto addresses = detail::interleave_families(
+      co_await async_resolve_cached(std::move(host)));
+  std::vector<tcping_endpoint_stats> endpoints(addresses.size());
+  for (std::size_t i = 0; i < addresses.size(); ++i) {
+    endpoints[i].endpoint = {addresses[i], port};
+  }
+
+  asio::steady_timer pacer(executor);
+  auto next_round = clock::now();
+  for (int round = 0; round < count; ++round) {
+    pacer.expires_at(next_round);
+    co_await pacer.async_wait(asio::use_awaitable);
+    next_round += interval;
+
+    detail::tcping_race race(executor, endpoints.size());
+    std::vector<asio::awaitable<void>> tasks;
+    tasks.reserve(endpoints.size() + 1);
+    tasks.push_back(detail::tcping_pace(attempt_delay, race));
+    for (std::size_t i = 0; i < endpoints.size(); ++i) {
+      tasks.push_back(detail::tcping_attempt(i, timeout, endpoints[i], race));
+    }
+    co_await join_all(std::move(tasks));
+  }
+
+  co_return endpoints;
+}
 } // namespace net
 
 #endif // TCPING_HPP
@@ -0,0 +1,198 @@
+#ifndef TRACERT_HPP
+#define TRACERT_HPP
+
+#include <asio.hpp>
+#include <asio/experimental/awaitable_operators.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "dns_cache.hpp"
+#include "icmp_dispatcher.hpp"
+#include "icmp_header.hpp"
+#include "icmp_utils.hpp"
+#include "metrics.hpp"
+
+namespace net {
+struct tracert_hop {
+  int ttl = 0;
+  asio::ip::address address;
+  // One entry per probe; empty when the probe timed out.
+  std::vector<std::optional<std::chrono::steady_clock::duration>> delays;
+};
+
+// Probes every TTL in parallel instead of hop by hop. Up to `window` TTLs
+// are in flight at once (0 means all of them); each hop's time exceeded
+// reply is matched by the probe quoted inside it, and once the destination
+// answers no TTL above it is sent or waited for. A full trace therefore
+// finishes in about one timeout.
+template <class IPType, class Rep, class Period,
+          class OIPT = std::remove_cvref_t<IPType>>
+  requires is_ip_token_v<OIPT>
+inline asio::awaitable<std::vector<tracert_hop>>
+async_tracert(std::string dest, int max_hops, int probes_per_hop,
+              std::chrono::duration<Rep, Period> timeout, int window,
+              IPType &&type) {
+  using namespace asio::experimental::awaitable_operators;
+  using clock = std::chrono::steady_clock;
+
+  auto executor = co_await asio::this_coro::executor;
+  auto addresses =
+      co_await async_resolve_cached(dest, address_family_of<OIPT>());
+  asio::ip::icmp::endpoint destination(addresses.front(), 0);
+  icmp_session<OIPT> session(executor);
+
+  max_hops = std::clamp(max_hops, 0, 255);
+  probes_per_hop = std::clamp(probes_per_hop, 1, 255);
+  const auto hop_count = static_cast<std::size_t>(max_hops);
+  const auto probe_count = static_cast<std::size_t>(probes_per_hop);
+  if (window <= 0) {
+    window = max_hops;
+  }
+
+  std::vector<tracert_hop> hops(hop_count);
+  std::vector<clock::time_point> sent_at(hop_count);
+  std::vector<std::size_t> answered(hop_count);
+  std::size_t hops_sent = 0;
+  // TTL of the first hop that turned out to be the end of the path.
+  std::size_t last_hop = hop_count;
+  bool sender_done = false;
+  asio::steady_timer window_timer(executor);
+
+  for (std::size_t i = 0; i < hop_count; ++i) {
+    hops[i].ttl = static_cast<int>(i + 1);
+    hops[i].delays.resize(probe_count);
+  }
+
+  auto is_finished = [&](std::size_t index, clock::time_point now) {
+    return answered[index] == probe_count || now - sent_at[index] >= timeout;
+  };
+
+  auto in_flight = [&](clock::time_point now) {
+    std::size_t count = 0;
+    for (std::size_t i = 0; i < std::min(hops_sent, last_hop); ++i) {
+      count += !is_finished(i, now);
+    }
+    return count;
+  };
+
+  auto send_all = [&]() -> asio::awaitable<void> {
+    // One template per probe, since a burst holds all of them at once.
+    std::vector<echo_request_template<OIPT>> requests;
+    requests.reserve(probe_count);
+    for (std::size_t probe = 0; probe < probe_count; ++probe) {
+      requests.emplace_back(session.identifier(), echo_body);
+    }
+    std::vector<icmp_probe> probes;
+    probes.reserve(probe_count);
+    for (std::size_t index = 0; index < hop_count && index < last_hop;
+         ++index) {
+      while (in_flight(clock::now()) >= static_cast<std::size_t>(window)) {
+        // Sleep until the oldest hop times out, or until the receiver
+        // cancels the timer because a hop finished early.
+        auto wake_at = clock::time_point::max();
+        for (std::size_t i = 0; i < std::min(hops_sent, last_hop); ++i) {
+          if (answered[i] != probe_count) {
+            wake_at = std::min(wake_at, sent_at[i] + timeout);
+          }
+        }
+        window_timer.expires_at(wake_at);
+        std::error_code ec;
+        co_await window_timer.async_wait(
+            asio::redirect_error(asio::use_awaitable, ec));
+      }
+      if (index >= last_hop) {
+        break;
+      }
+
+      // All probes of a hop leave as one burst.
+      probes.clear();
+      for (std::size_t probe = 0; probe < probe_count; ++probe) {
+        probes.push_back(
+            {requests[probe].next(
+                 static_cast<unsigned short>(index * probe_count + probe)),
+             destination});
+      }
+      std::error_code ec;
+      sent_at[index] = co_await session.send_batch(
+          probes, static_cast<int>(index + 1), ec);
+      hops_sent = index + 1;
+    }
+    sender_done = true;
+  };
+
+  auto receive_all = [&]() -> asio::awaitable<void> {
+    for (;;) {
+      auto now = clock::now();
+      auto wake_at = now + timeout;
+      bool pending = !sender_done;
+      for (std::size_t i = 0; i < std::min(hops_sent, last_hop); ++i) {
+        if (!is_finished(i, now)) {
+          pending = true;
+          wake_at = std::min(wake_at, sent_at[i] + timeout);
+        }
+      }
+      if (!pending) {
+        break;
+      }
+
+      auto reply = co_await session.receive(wake_at);
+      if (!reply) {
+        window_timer.cancel();
+        continue;
+      }
+
+      const auto &icmp_hdr = reply->icmp_hdr;
+      asio::ip::address source = reply->ip_hdr.source_address();
+      std::size_t index = icmp_hdr.sequence_number() / probe_count;
+      std::size_t probe = icmp_hdr.sequence_number() % probe_count;
+      if (index >= hops_sent || hops[index].delays[probe]) {
+        continue;
+      }
+      auto elapsed = reply->received_at - sent_at[index];
+      if (elapsed > timeout) {
+        continue;
+      }
+
+      hops[index].delays[probe] = elapsed;
+      if (hops[index].address.is_unspecified()) {
+        hops[index].address = source;
+      }
+      ++answered[index];
+      if (icmp_hdr.type() !=
+              select_icmp_type<OIPT>(icmp_header::ipv4::time_exceeded,
+                                     icmp_header::ipv6::time_exceeded) ||
+          source == destination.address()) {
+        last_hop = std::min(last_hop, index + 1);
+      }
+      window_timer.cancel();
+    }
+  };
+
+  co_await (send_all() && receive_all());
+  hops.resize(std::min(hops_sent, last_hop));
+  std::uint64_t unanswered = 0;
+  for (std::size_t i = 0; i < hops.size(); ++i) {
+    unanswered += probe_count - answered[i];
+  }
+  module_metrics::instance().icmp<OIPT>().probe_timeouts.add(unanswered);
+
+  // A destination that never answers would otherwise end in a long run of
+  // silent hops; keep at most `silent_hops` of them after the last reply.
+  if (last_hop == hop_count) {
+    constexpr std::size_t silent_hops = 10;
+    auto last_reply = std::find_if(hops.rbegin(), hops.rend(), [](auto &hop) {
+      return !hop.address.is_unspecified();
+    });
+    auto keep = static_cast<std::size_t>(hops.rend() - last_reply);
+    hops.resize(std::min(hops.size(), keep + silent_hops));
+  }
+  co_return hops;
+}
+} // namespace net
+
+#endif // TRACERT_HPP
@@ -7,7 +7,7 @@ from nonebot.exception import FinishedException
 
 from . import network_utils_externel_cpp
 from .utils.format import format_ping_result, format_whois_result
-from .utils.resolver import resolve_domain
+from .utils.resolver import resolve_addresses
 from .utils.whois import whois_query
 
 __plugin_name__ = "NetworkTools"
@@ -27,6 +27,7 @@ async def handle_ping(args: Message = CommandArg()):
             count = 4
             ttl = 64
             timeout = 1000
+            interval = 0
             use_ipv4 = False
             use_ipv6 = False
             start_msg = []
@@ -46,6 +47,9 @@ async def handle_ping(args: Message = CommandArg()):
                 elif arg_list[i] == "-w" and i + 1 < len(arg_list):
                     timeout = int(arg_list[i + 1])
                     i += 1
+                elif arg_list[i] == "-I" and i + 1 < len(arg_list):
+                    interval = int(arg_list[i + 1])
+                    i += 1
                 else:
                     try:
                         count = int(arg_list[i])
@@ -54,6 +58,8 @@ async def handle_ping(args: Message = CommandArg()):
                 i += 1
             
             start_msg.append(f"主机名：{host}，次数：{count}, TTL：{ttl}, 超时：{timeout}毫秒")
+            if interval > 0:
+                start_msg.append(f"，发包间隔：{interval}毫秒")
         
             if 'force_ipv4' in locals() and 'force_ipv6' in locals():
                 await ping.finish("不能同时指定 -4 和 -6 选项。")
@@ -79,8 +85,7 @@ async def handle_ping(args: Message = CommandArg()):
                 except ValueError:
                     # 如果不是有效的 IP 地址，则尝试 DNS 解析，传出地址（取第一个）
                     start_msg.append("，目标为域名，解析结果：")
-                    a_records = await resolve_domain(host, "A")
-                    aaaa_records = await resolve_domain(host, "AAAA")
+                    a_records, aaaa_records = await resolve_addresses(host)
                     if a_records:
                         use_ipv4 = True
                         start_msg.append(f"\nA记录：{a_records} ")
@@ -93,28 +98,28 @@ async def handle_ping(args: Message = CommandArg()):
             try:
                 if use_ipv4 and use_ipv6:
                     await ping.send("发现这是一个双栈地址，同时进行 IPv4 和 IPv6 测试。")
+                    # 两个地址族在 C++ 侧并发测试，耗时取决于较慢的一方
+                    result = await network_utils_externel_cpp.ping_dual_async(host, count, ttl, timeout, interval)
                     try:
-                        result4 = network_utils_externel_cpp.ping(host, count, ttl, timeout)
-                        formatted_result4 = format_ping_result(result4)
+                        formatted_result4 = format_ping_result(result["ipv4"])
                         await ping.send(f"IPv4 测试结果:\n{formatted_result4}")
                     except FinishedException:
                         raise
                     except Exception as e:
                         await ping.send(f"执行 IPv4 ping 命令时出错: {e}, 这可能是由于目标主机不可达或域名解析失败导致的。")
                     try:
-                        result6 = network_utils_externel_cpp.pingv6(host, count, ttl, timeout)
-                        formatted_result6 = format_ping_result(result6)
+                        formatted_result6 = format_ping_result(result["ipv6"])
                         await ping.finish(f"IPv6 测试结果:\n{formatted_result6}")
                     except FinishedException:
                         raise
                     except Exception as e:
                         await ping.send(f"执行 IPv6 ping 命令时出错: {e}, 这可能是由于目标主机不可达或域名解析失败导致的。")
                 elif use_ipv4:
-                    result = network_utils_externel_cpp.ping(host, count, ttl, timeout)
+                    result = await network_utils_externel_cpp.ping_async(host, count, ttl, timeout, interval, compact=True)
                     formatted_result = format_ping_result(result)
                     await ping.finish(formatted_result)                       
                 elif use_ipv6:
-                    result = network_utils_externel_cpp.pingv6(host, count, ttl, timeout)
+                    result = await network_utils_externel_cpp.pingv6_async(host, count, ttl, timeout, interval, compact=True)
                     formatted_result = format_ping_result(result)
                     await ping.finish(formatted_result)
 
@@ -127,7 +132,7 @@ async def handle_ping(args: Message = CommandArg()):
                 await ping.finish("未能正确识别到地址类型，请重试。")
 
     else:
-        await ping.finish(f"用法: ping <host> [-4|-6] [-i ttl] [-w timeout] [count]\n示例: ping example.com -4 -i 64 -w 1000 4")
+        await ping.finish(f"用法: ping <host> [-4|-6] [-i ttl] [-w timeout] [-I interval] [count]\n示例: ping example.com -4 -i 64 -w 1000 4")
 
 @whois.handle()
 async def handle_whois(args: Message = CommandArg()):
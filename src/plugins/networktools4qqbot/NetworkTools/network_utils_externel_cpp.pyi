@@ -2,25 +2,232 @@
 A Cpp network utils module for python
 """
 from __future__ import annotations
+import collections.abc
 import typing
-__all__: list[str] = ['ping', 'pingv6', 'tcping', 'tracert', 'tracertv6']
-def ping(arg0: str, arg1: typing.SupportsInt | typing.SupportsIndex, arg2: typing.SupportsInt | typing.SupportsIndex, arg3: typing.SupportsInt | typing.SupportsIndex) -> list:
+__all__: list[str] = ['PingTable', 'TableColumn', 'clear_dns_cache', 'clear_probe_cache', 'dns_cache_stats', 'dns_lookup', 'dns_lookup_async', 'engine_threads', 'icmp_io_stats', 'icmp_packets_received', 'metrics', 'metrics_prometheus', 'ping', 'ping_async', 'ping_dual', 'ping_dual_async', 'ping_many', 'ping_many_async', 'ping_stats', 'ping_stats_async', 'pingv6', 'pingv6_async', 'pingv6_stats', 'pingv6_stats_async', 'port_scan', 'port_scan_async', 'probe_cache_stats', 'set_batched_io', 'set_engine_threads', 'set_icmp_filter', 'set_icmp_transport', 'set_kernel_timestamps', 'set_probe_cache', 'sweep', 'sweep_async', 'tcping', 'tcping_async', 'tcping_stats', 'tcping_stats_async', 'tracert', 'tracert_async', 'tracertv6', 'tracertv6_async']
+class PingTable:
+    def __len__(self) -> int:
+        ...
+    @property
+    def address(self) -> str:
+        ...
+    @property
+    def avg_us(self) -> float:
+        ...
+    @property
+    def bytes(self) -> TableColumn:
+        ...
+    @property
+    def codes(self) -> TableColumn:
+        ...
+    @property
+    def loss(self) -> float:
+        ...
+    @property
+    def max_us(self) -> float:
+        ...
+    @property
+    def mdev_us(self) -> float:
+        ...
+    @property
+    def message(self) -> str:
+        ...
+    @property
+    def min_us(self) -> float:
+        ...
+    @property
+    def received(self) -> int:
+        ...
+    @property
+    def rtt_us(self) -> TableColumn:
+        ...
+    @property
+    def sequence(self) -> TableColumn:
+        ...
+    @property
+    def stats(self) -> dict:
+        ...
+    @property
+    def status(self) -> str:
+        ...
+    @property
+    def transmitted(self) -> int:
+        ...
+    @property
+    def ttl(self) -> TableColumn:
+        ...
+class TableColumn:
+    def __buffer__(self, flags):
+        """
+        Return a buffer object that exposes the underlying memory of the object.
+        """
+    def __len__(self) -> int:
+        ...
+    def __release_buffer__(self, buffer):
+        """
+        Release the buffer object that exposes the underlying memory of the object.
+        """
+def clear_dns_cache() -> None:
+    """
+    drop every name from the shared dns cache
+    """
+def clear_probe_cache() -> None:
+    """
+    drop every cached ping and tracert result
+    """
+def dns_cache_stats() -> dict:
+    """
+    hits, misses and entries of the shared dns cache
+    """
+def dns_lookup(host: str, server: str = '', port: typing.SupportsInt | typing.SupportsIndex = 53, timeout: typing.SupportsInt | typing.SupportsIndex = 2000, deadline: typing.SupportsInt | typing.SupportsIndex = 0) -> dict:
+    """
+    query the A and AAAA records of a host in parallel
+    """
+def dns_lookup_async(host: str, server: str = '', port: typing.SupportsInt | typing.SupportsIndex = 53, timeout: typing.SupportsInt | typing.SupportsIndex = 2000, deadline: typing.SupportsInt | typing.SupportsIndex = 0) -> typing.Any:
+    """
+    query the A and AAAA records of a host, returning an asyncio future
+    """
+def engine_threads() -> dict:
+    """
+    the engine threads probes are spread over, and the most it can use
+    """
+def icmp_io_stats() -> dict:
+    """
+    icmp packets and system calls per direction and address family
+    """
+def icmp_packets_received() -> dict:
+    """
+    icmp packets that reached userspace, per address family
+    """
+def metrics() -> dict:
+    """
+    probe counters, queue depths and per-stage timings since import
+    """
+def metrics_prometheus() -> str:
+    """
+    the metrics in the prometheus text format, for an exporter to serve
+    """
+def ping(dest: str, count: typing.SupportsInt | typing.SupportsIndex, ttl: typing.SupportsInt | typing.SupportsIndex, timeout: typing.SupportsInt | typing.SupportsIndex, interval: typing.SupportsInt | typing.SupportsIndex = 0, compact: bool = False, deadline: typing.SupportsInt | typing.SupportsIndex = 0) -> list | PingTable:
     """
     ping the destination
     """
-def pingv6(arg0: str, arg1: typing.SupportsInt | typing.SupportsIndex, arg2: typing.SupportsInt | typing.SupportsIndex, arg3: typing.SupportsInt | typing.SupportsIndex) -> list:
+def ping_async(dest: str, count: typing.SupportsInt | typing.SupportsIndex, ttl: typing.SupportsInt | typing.SupportsIndex, timeout: typing.SupportsInt | typing.SupportsIndex, interval: typing.SupportsInt | typing.SupportsIndex = 0, compact: bool = False, deadline: typing.SupportsInt | typing.SupportsIndex = 0) -> typing.Any:
+    """
+    ping the destination, returning an asyncio future
+    """
+def ping_dual(dest: str, count: typing.SupportsInt | typing.SupportsIndex, ttl: typing.SupportsInt | typing.SupportsIndex, timeout: typing.SupportsInt | typing.SupportsIndex, interval: typing.SupportsInt | typing.SupportsIndex = 0, deadline: typing.SupportsInt | typing.SupportsIndex = 0) -> dict:
+    """
+    ping the ipv4 and ipv6 addresses of the destination concurrently
+    """
+def ping_dual_async(dest: str, count: typing.SupportsInt | typing.SupportsIndex, ttl: typing.SupportsInt | typing.SupportsIndex, timeout: typing.SupportsInt | typing.SupportsIndex, interval: typing.SupportsInt | typing.SupportsIndex = 0, deadline: typing.SupportsInt | typing.SupportsIndex = 0) -> typing.Any:
+    """
+    ping the ipv4 and ipv6 addresses of the destination concurrently, returning an asyncio future
+    """
+def ping_many(targets: collections.abc.Sequence[str], count: typing.SupportsInt | typing.SupportsIndex, ttl: typing.SupportsInt | typing.SupportsIndex, timeout: typing.SupportsInt | typing.SupportsIndex, interval: typing.SupportsInt | typing.SupportsIndex = 0, compact: bool = False, deadline: typing.SupportsInt | typing.SupportsIndex = 0) -> list:
+    """
+    ping many destinations over one socket per address family
+    """
+def ping_many_async(targets: collections.abc.Sequence[str], count: typing.SupportsInt | typing.SupportsIndex, ttl: typing.SupportsInt | typing.SupportsIndex, timeout: typing.SupportsInt | typing.SupportsIndex, interval: typing.SupportsInt | typing.SupportsIndex = 0, compact: bool = False, deadline: typing.SupportsInt | typing.SupportsIndex = 0) -> typing.Any:
+    """
+    ping many destinations, returning an asyncio future
+    """
+def ping_stats(dest: str, count: typing.SupportsInt | typing.SupportsIndex, ttl: typing.SupportsInt | typing.SupportsIndex, timeout: typing.SupportsInt | typing.SupportsIndex, interval: typing.SupportsInt | typing.SupportsIndex = 0, deadline: typing.SupportsInt | typing.SupportsIndex = 0) -> dict:
+    """
+    ping the destination keeping only running statistics, for any count in constant memory
+    """
+def ping_stats_async(dest: str, count: typing.SupportsInt | typing.SupportsIndex, ttl: typing.SupportsInt | typing.SupportsIndex, timeout: typing.SupportsInt | typing.SupportsIndex, interval: typing.SupportsInt | typing.SupportsIndex = 0, deadline: typing.SupportsInt | typing.SupportsIndex = 0) -> typing.Any:
+    """
+    ping_stats, returning an asyncio future
+    """
+def pingv6(dest: str, count: typing.SupportsInt | typing.SupportsIndex, ttl: typing.SupportsInt | typing.SupportsIndex, timeout: typing.SupportsInt | typing.SupportsIndex, interval: typing.SupportsInt | typing.SupportsIndex = 0, compact: bool = False, deadline: typing.SupportsInt | typing.SupportsIndex = 0) -> list | PingTable:
     """
     ping the destination in ipv6
     """
-def tcping(arg0: str, arg1: typing.SupportsInt | typing.SupportsIndex, arg2: typing.SupportsInt | typing.SupportsIndex) -> dict:
+def pingv6_async(dest: str, count: typing.SupportsInt | typing.SupportsIndex, ttl: typing.SupportsInt | typing.SupportsIndex, timeout: typing.SupportsInt | typing.SupportsIndex, interval: typing.SupportsInt | typing.SupportsIndex = 0, compact: bool = False, deadline: typing.SupportsInt | typing.SupportsIndex = 0) -> typing.Any:
+    """
+    ping the destination in ipv6, returning an asyncio future
+    """
+def pingv6_stats(dest: str, count: typing.SupportsInt | typing.SupportsIndex, ttl: typing.SupportsInt | typing.SupportsIndex, timeout: typing.SupportsInt | typing.SupportsIndex, interval: typing.SupportsInt | typing.SupportsIndex = 0, deadline: typing.SupportsInt | typing.SupportsIndex = 0) -> dict:
+    """
+    ping_stats in ipv6
+    """
+def pingv6_stats_async(dest: str, count: typing.SupportsInt | typing.SupportsIndex, ttl: typing.SupportsInt | typing.SupportsIndex, timeout: typing.SupportsInt | typing.SupportsIndex, interval: typing.SupportsInt | typing.SupportsIndex = 0, deadline: typing.SupportsInt | typing.SupportsIndex = 0) -> typing.Any:
+    """
+    ping_stats in ipv6, returning an asyncio future
+    """
+def port_scan(host: str, first_port: typing.SupportsInt | typing.SupportsIndex, last_port: typing.SupportsInt | typing.SupportsIndex, max_in_flight: typing.SupportsInt | typing.SupportsIndex = 256, timeout: typing.SupportsInt | typing.SupportsIndex = 1000, deadline: typing.SupportsInt | typing.SupportsIndex = 0) -> dict:
+    """
+    connect to a range of tcp ports concurrently and sort them into open, closed, filtered, failed and unscanned
+    """
+def port_scan_async(host: str, first_port: typing.SupportsInt | typing.SupportsIndex, last_port: typing.SupportsInt | typing.SupportsIndex, max_in_flight: typing.SupportsInt | typing.SupportsIndex = 256, timeout: typing.SupportsInt | typing.SupportsIndex = 1000, deadline: typing.SupportsInt | typing.SupportsIndex = 0) -> typing.Any:
+    """
+    port_scan, returning an asyncio future
+    """
+def probe_cache_stats() -> dict:
+    """
+    hits, joins and misses of the shared probe cache, and its settings
+    """
+def set_batched_io(enabled: bool) -> None:
+    """
+    send and read icmp packets in batches (sendmmsg/recvmmsg)
+    """
+def set_engine_threads(count: typing.SupportsInt | typing.SupportsIndex) -> None:
+    """
+    spread probes started from now on over this many engine threads, each with its own sockets; at most one per core
+    """
+def set_icmp_filter(enabled: bool) -> None:
+    """
+    attach a kernel filter for our own replies to raw icmp sockets opened from now on
+    """
+def set_icmp_transport(name: str) -> None:
+    """
+    choose 'auto', 'raw' or 'datagram' icmp sockets for sockets opened from now on
+    """
+def set_kernel_timestamps(enabled: bool) -> None:
+    """
+    time replies with kernel receive timestamps on icmp sockets opened from now on
+    """
+def set_probe_cache(freshness: typing.SupportsInt | typing.SupportsIndex = 5000, capacity: typing.SupportsInt | typing.SupportsIndex = 64) -> None:
+    """
+    set how long identical ping and tracert results are reused, in ms, and how many are kept; 0 only merges probes in flight
+    """
+def sweep(cidr: str, rate: float = 100.0, burst: float = 10.0, window: typing.SupportsInt | typing.SupportsIndex = 256, timeout: typing.SupportsInt | typing.SupportsIndex = 1000, on_reply: typing.Any = None, deadline: typing.SupportsInt | typing.SupportsIndex = 0) -> dict:
+    """
+    ping every address of a cidr prefix at a limited rate, calling on_reply(address, time_us) for each reply if given
+    """
+def sweep_async(cidr: str, rate: float = 100.0, burst: float = 10.0, window: typing.SupportsInt | typing.SupportsIndex = 256, timeout: typing.SupportsInt | typing.SupportsIndex = 1000, on_reply: typing.Any = None, deadline: typing.SupportsInt | typing.SupportsIndex = 0) -> typing.Any:
+    """
+    sweep, returning an asyncio future; on_reply is called on the loop
+    """
+def tcping(host: str, port: typing.SupportsInt | typing.SupportsIndex, timeout: typing.SupportsInt | typing.SupportsIndex, deadline: typing.SupportsInt | typing.SupportsIndex = 0) -> dict:
     """
     tcping a host
     """
-def tracert(arg0: str, arg1: typing.SupportsInt | typing.SupportsIndex, arg2: typing.SupportsInt | typing.SupportsIndex) -> list:
+def tcping_async(host: str, port: typing.SupportsInt | typing.SupportsIndex, timeout: typing.SupportsInt | typing.SupportsIndex, deadline: typing.SupportsInt | typing.SupportsIndex = 0) -> typing.Any:
+    """
+    tcping a host, returning an asyncio future
+    """
+def tcping_stats(host: str, port: typing.SupportsInt | typing.SupportsIndex, count: typing.SupportsInt | typing.SupportsIndex = 4, timeout: typing.SupportsInt | typing.SupportsIndex = 1000, interval: typing.SupportsInt | typing.SupportsIndex = 1000, attempt_delay: typing.SupportsInt | typing.SupportsIndex = 0, deadline: typing.SupportsInt | typing.SupportsIndex = 0) -> dict:
+    """
+    connect to every address of a host over several rounds and report per-address connect times in microseconds
+    """
+def tcping_stats_async(host: str, port: typing.SupportsInt | typing.SupportsIndex, count: typing.SupportsInt | typing.SupportsIndex = 4, timeout: typing.SupportsInt | typing.SupportsIndex = 1000, interval: typing.SupportsInt | typing.SupportsIndex = 1000, attempt_delay: typing.SupportsInt | typing.SupportsIndex = 0, deadline: typing.SupportsInt | typing.SupportsIndex = 0) -> typing.Any:
+    """
+    tcping_stats, returning an asyncio future
+    """
+def tracert(dest: str, hops_count: typing.SupportsInt | typing.SupportsIndex, timeout: typing.SupportsInt | typing.SupportsIndex, window: typing.SupportsInt | typing.SupportsIndex = 0, deadline: typing.SupportsInt | typing.SupportsIndex = 0) -> list:
     """
     tracert the destination
     """
-def tracertv6(arg0: str, arg1: typing.SupportsInt | typing.SupportsIndex, arg2: typing.SupportsInt | typing.SupportsIndex) -> list:
+def tracert_async(dest: str, hops_count: typing.SupportsInt | typing.SupportsIndex, timeout: typing.SupportsInt | typing.SupportsIndex, window: typing.SupportsInt | typing.SupportsIndex = 0, deadline: typing.SupportsInt | typing.SupportsIndex = 0) -> typing.Any:
+    """
+    tracert the destination, returning an asyncio future
+    """
+def tracertv6(dest: str, hops_count: typing.SupportsInt | typing.SupportsIndex, timeout: typing.SupportsInt | typing.SupportsIndex, window: typing.SupportsInt | typing.SupportsIndex = 0, deadline: typing.SupportsInt | typing.SupportsIndex = 0) -> list:
     """
     tracert the destination in ipv6
     """
+def tracertv6_async(dest: str, hops_count: typing.SupportsInt | typing.SupportsIndex, timeout: typing.SupportsInt | typing.SupportsIndex, window: typing.SupportsInt | typing.SupportsIndex = 0, deadline: typing.SupportsInt | typing.SupportsIndex = 0) -> typing.Any:
+    """
+    tracert the destination in ipv6, returning an asyncio future
+    """
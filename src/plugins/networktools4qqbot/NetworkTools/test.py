@@ -1,8 +1,119 @@
 import network_utils_externel_cpp
+import asyncio
 import json
+import socket
+import socketserver
+import struct
+import threading
+import time
 
 print(json.dumps(network_utils_externel_cpp.ping("183.6.16.5", 4, 64, 1000), indent=4)) # host times ttl timeout
+print(json.dumps(network_utils_externel_cpp.ping_many(["183.6.16.5", "::1", "qqof.net"], 4, 64, 1000), indent=4)) # hosts times ttl timeout
 print(json.dumps(network_utils_externel_cpp.pingv6("::1", 4, 64, 500), indent=4))
 print(json.dumps(network_utils_externel_cpp.tracert("qqof.net", 30, 10), indent=4)) # host hops timeout
 print(json.dumps(network_utils_externel_cpp.tracertv6("::1", 30, 10), indent=4)) # host hops timeout
 print(json.dumps(network_utils_externel_cpp.tcping("127.0.0.1", 25565, 1000), indent=4)) # host port timeout
+print(json.dumps(network_utils_externel_cpp.tcping_stats("localhost", 25565, 10, 1000, 100), indent=4)) # host port rounds timeout interval
+
+# batched vs per-packet icmp I/O: packets per second and packets per system call
+for batched in (True, False):
+    network_utils_externel_cpp.set_batched_io(batched)
+    before = network_utils_externel_cpp.icmp_io_stats()["ipv4"]
+    start = time.perf_counter()
+    network_utils_externel_cpp.ping_many([f"127.0.0.{i}" for i in range(1, 201)], 10, 64, 1000)
+    elapsed = time.perf_counter() - start
+    after = network_utils_externel_cpp.icmp_io_stats()["ipv4"]
+    sent = after["packets_sent"] - before["packets_sent"]
+    received = after["packets_received"] - before["packets_received"]
+    print(f"batched={batched}: {sent / elapsed:.0f} pps sent, "
+          f"{sent / max(after['send_calls'] - before['send_calls'], 1):.1f} packets/send call, "
+          f"{received / max(after['receive_calls'] - before['receive_calls'], 1):.1f} packets/receive call")
+
+# dns_lookup against a local stand-in server: A is answered over UDP, AAAA is
+# truncated over UDP and answered over TCP
+def stand_in_answer(query: bytes, tcp: bool) -> bytes:
+    qtype = struct.unpack("!H", query[-4:-2])[0]
+    if qtype == 28 and not tcp:
+        return query[:2] + b"\x83\x80" + query[4:]
+    rdata = bytes([127, 0, 0, 1]) if qtype == 1 else bytes(15) + b"\x01"
+    answer = b"\xc0\x0c" + struct.pack("!HHIH", qtype, 1, 300, len(rdata)) + rdata
+    return query[:2] + b"\x81\x80" + query[4:6] + b"\x00\x01\x00\x00\x00\x00" + query[12:] + answer
+
+class StandInUDP(socketserver.BaseRequestHandler):
+    def handle(self):
+        data, sock = self.request
+        sock.sendto(stand_in_answer(data, False), self.client_address)
+
+class StandInTCP(socketserver.BaseRequestHandler):
+    def handle(self):
+        length = struct.unpack("!H", self.request.recv(2))[0]
+        reply = stand_in_answer(self.request.recv(length), True)
+        self.request.sendall(struct.pack("!H", len(reply)) + reply)
+
+for server in (socketserver.UDPServer(("127.0.0.1", 5353), StandInUDP),
+               socketserver.TCPServer(("127.0.0.1", 5353), StandInTCP)):
+    threading.Thread(target=server.serve_forever, daemon=True).start()
+print(json.dumps(network_utils_externel_cpp.dns_lookup("example.com", "127.0.0.1", 5353, 1000), indent=4))
+
+# port_scan against listeners on localhost: 20001 and 20003 are open, the rest
+# of the range refuses
+listeners = []
+for port in (20001, 20003):
+    listener = socket.create_server(("127.0.0.1", port))
+    listeners.append(listener)
+scan = network_utils_externel_cpp.port_scan("127.0.0.1", 20000, 20010, 4, 500, 5000)
+print(scan["open"], scan["open_us"], scan["closed"], scan["filtered"])
+
+# sweep 127.0.0.0/28, streaming the replies; every loopback address answers
+print(network_utils_externel_cpp.sweep("127.0.0.0/28", 50.0, 4.0, 8, 1000,
+                                       lambda address, time_us: print(address, time_us)))
+
+# the compact result: one typed array per field, statistics computed in C++
+table = network_utils_externel_cpp.ping("127.0.0.1", 4, 64, 1000, compact=True)
+print(len(table), table.address, list(memoryview(table.rtt_us)), table.avg_us, table.mdev_us)
+
+# running statistics only: memory stays constant for any count
+print(json.dumps(network_utils_externel_cpp.ping_stats("127.0.0.1", 1000, 64, 1000, 1), indent=4))
+
+# identical pings in flight together run once; a repeat within the freshness
+# window is answered from the cache
+async def coalesced_pings():
+    return await asyncio.gather(*(network_utils_externel_cpp.ping_async("127.0.0.1", 2, 64, 1000) for _ in range(3)))
+asyncio.run(coalesced_pings())
+network_utils_externel_cpp.ping("127.0.0.1", 2, 64, 1000)
+print(network_utils_externel_cpp.probe_cache_stats())
+
+# a deadline bounds the whole call: 10 probes of 1s to a silent address stop
+# after 500 ms with a timed out error
+print(network_utils_externel_cpp.ping("192.0.2.1", 10, 64, 1000, deadline=500))
+
+# a call that fails straight away still does so under a deadline, with its own
+# error rather than a timed out one after the whole deadline
+started = time.perf_counter()
+print(network_utils_externel_cpp.ping("name.invalid", 4, 64, 1000, deadline=5000))
+assert time.perf_counter() - started < 1, "an immediate failure waited out the deadline"
+
+# cancelling the future from asyncio stops the probes on the engine as well
+async def cancelled_ping():
+    try:
+        await asyncio.wait_for(network_utils_externel_cpp.ping_async("192.0.2.1", 10, 64, 1000), 0.5)
+    except asyncio.TimeoutError:
+        print("cancelled")
+asyncio.run(cancelled_ping())
+
+# probes per second against the loopback as engine threads are added; each
+# ping targets its own address so none are merged by the probe cache
+async def loopback_pings(total):
+    return await asyncio.gather(*(network_utils_externel_cpp.ping_async(f"127.0.{i // 250}.{i % 250 + 1}", 4, 64, 1000)
+                                  for i in range(total)))
+network_utils_externel_cpp.set_probe_cache(0, 0)
+for threads in range(1, network_utils_externel_cpp.engine_threads()["max_threads"] + 1):
+    network_utils_externel_cpp.set_engine_threads(threads)
+    started = time.perf_counter()
+    asyncio.run(loopback_pings(2000))
+    print(threads, "threads:", round(2000 * 4 / (time.perf_counter() - started)), "probes/s")
+network_utils_externel_cpp.set_engine_threads(1)
+
+# what the module did in this run, as a dict and as a prometheus scrape
+print(json.dumps(network_utils_externel_cpp.metrics()["icmp"], indent=4))
+print(network_utils_externel_cpp.metrics_prometheus())
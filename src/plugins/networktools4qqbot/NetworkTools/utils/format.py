@@ -1,7 +1,38 @@
 import json
 from .resolver import resolve_domain
 
+def _rtt_ms(r: dict) -> float:
+    # 优先使用微秒精度的 RTT
+    if r.get("time_us") is not None:
+        return r.get("time_us") / 1000
+    return r.get("time")
+
+def format_ping_table(table) -> str:
+    # C++ 侧返回的 PingTable: 每个字段一个连续数组，统计值已预先算好
+    if table.status != "success":
+        raise RuntimeError(table.message)
+    address = table.address or None
+    output_lines = []
+    if len(table) > 10:
+        output_lines.append(f"结果过多，不显示明细结果。\n响应IP: {address}")
+    else:
+        output_lines.append(f"响应IP: {address}")
+        rows = zip(memoryview(table.codes), memoryview(table.bytes), memoryview(table.sequence),
+                   memoryview(table.ttl), memoryview(table.rtt_us))
+        for code, size, seq, ttl, rtt_us in rows:
+            if code == 0:
+                output_lines.append(f"{size} bytes from {address}: icmp_seq={seq}ttl={ttl} time={rtt_us / 1000:.3f} ms")
+            else:
+                output_lines.append(f"Request timeout")
+    output_lines.append(f"\n--- Ping statistics ---")
+    output_lines.append(f"{table.transmitted} packets transmitted, {table.received} packets received, {table.loss:.1f}% packet loss")
+    if table.received > 0:
+        output_lines.append(f"rtt min/avg/max/mdev = {table.min_us / 1000:.3f}/{table.avg_us / 1000:.3f}/{table.max_us / 1000:.3f}/{table.mdev_us / 1000:.3f} ms")
+    return "\n".join(output_lines)
+
 def format_ping_result(result: list) -> str:
+    if not isinstance(result, list):
+        return format_ping_table(result)
     # 汇总结果
     # 总传输包
     transmitted = len(result)
@@ -10,11 +41,11 @@ def format_ping_result(result: list) -> str:
     # 丢包率
     loss_percentage = ((transmitted - received) / transmitted) * 100 if transmitted > 0 else 0
     # RTT 统计
-    min_time = min((r.get("time") for r in result if r.get("status") == "success"), default=0)
-    max_time = max((r.get("time") for r in result if r.get("status") == "success"), default=0)
-    avg_time = sum((r.get("time") for r in result if r.get("status") == "success"), 0) / received if received > 0 else 0
+    min_time = min((_rtt_ms(r) for r in result if r.get("status") == "success"), default=0)
+    max_time = max((_rtt_ms(r) for r in result if r.get("status") == "success"), default=0)
+    avg_time = sum((_rtt_ms(r) for r in result if r.get("status") == "success"), 0) / received if received > 0 else 0
     # 抖动
-    stddev_time = (sum((r.get("time") - avg_time) ** 2 for r in result if r.get("status") == "success") / received) ** 0.5 if received > 0 else 0
+    stddev_time = (sum((_rtt_ms(r) - avg_time) ** 2 for r in result if r.get("status") == "success") / received) ** 0.5 if received > 0 else 0
     # 响应的地址
     address = None
     for r in result:
@@ -41,7 +72,7 @@ def format_ping_result(result: list) -> str:
             if r.get("status") == "success":
                 if r.get("ttl") is not None:
                     ttl_result = f"ttl={r.get('ttl')}"
-                output_lines.append(f"{r.get('bytes')} bytes from {r.get('address')}: icmp_seq={r.get('icmp_seq')}{ttl_result} time={r.get('time')} ms")
+                output_lines.append(f"{r.get('bytes')} bytes from {r.get('address')}: icmp_seq={r.get('icmp_seq')}{ttl_result} time={_rtt_ms(r):.3f} ms")
             else:
                 output_lines.append(f"Request timeout")
     output_lines.append(f"\n--- Ping statistics ---")
@@ -1,16 +1,37 @@
+import asyncio
+
 import dns.resolver
 
+from .. import network_utils_externel_cpp
 
-async def resolve_domain(domain: str, record_type: str) -> list:
+
+async def resolve_addresses(domain: str) -> tuple[list, list]:
     """
-    解析域名，返回指定类型的 DNS 记录列表
+    并行解析域名的 A 和 AAAA 记录，不阻塞事件循环
     :param domain: 需要解析的域名
-    :param record_type: 记录类型，如 A、AAAA、CNAME 等
-    :return: 解析结果列表
+    :return: (A 记录列表, AAAA 记录列表)
     """
+    result = await network_utils_externel_cpp.dns_lookup_async(domain)
+    return result.get("a", []), result.get("aaaa", [])
+
+
+def _query(domain: str, record_type: str) -> list:
     try:
         answers = dns.resolver.query(domain, record_type)
-        for rdata in answers:
-            return [str(rdata) for rdata in answers]
+        return [str(rdata) for rdata in answers]
     except Exception as e:
         return []
+
+
+async def resolve_domain(domain: str, record_type: str) -> list:
+    """
+    解析域名，返回指定类型的 DNS 记录列表
+    :param domain: 需要解析的域名
+    :param record_type: 记录类型，如 A、AAAA、CNAME 等
+    :return: 解析结果列表
+    """
+    if record_type in ("A", "AAAA"):
+        a_records, aaaa_records = await resolve_addresses(domain)
+        return a_records if record_type == "A" else aaaa_records
+    # 其他记录类型仍由 dnspython 查询，放到线程中以免阻塞事件循环
+    return await asyncio.to_thread(_query, domain, record_type)